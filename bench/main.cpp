@@ -0,0 +1,325 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "syntheticdb.h"
+#include "chainwalker.h"
+#include "contactsettings.h"
+#include "eventtext.h"
+#include "extractionschema.h"
+#include "jsonwriter.h"
+#include "miranda.h"
+#include "mirandadbimage.h"
+#include "recordcarver.h"
+#include "recoverystats.h"
+#include "signaturescanner.h"
+#include "textsanitizer.h"
+#include <QtArgumentParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QTextCodec>
+#include <QThread>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+
+void printUsage()
+{
+    std::cout << "mirandadbbench"                       << std::endl
+              << "    Measure the recovery of the synthetic miranda database" << std::endl
+              << "Usage:"                               << std::endl
+              << "    mirandadbbench [--contacts N] [--events N] [--text-size N] [--seed N]" << std::endl
+              << "                   [--zero-pages N] [--truncate N] [--flips N] [-j N] [--db FILE]" << std::endl
+              << "Options:"                             << std::endl
+              << "    --contacts number of contacts (1000)"                   << std::endl
+              << "    --events number of events per contact (100)"            << std::endl
+              << "    --text-size average size of the event text (200)"       << std::endl
+              << "    --seed seed of the generator (1)"                       << std::endl
+              << "    --zero-pages number of 4KB pages filled by zero"        << std::endl
+              << "    --truncate number of event chains cut in the middle"    << std::endl
+              << "    --flips number of random bit flips"                     << std::endl
+              << "    -j number of threads (0 - number of cores)"             << std::endl
+              << "    --db keep the generated database in the file"           << std::endl;
+}
+
+
+// the resident size of the process, the anonymous one doesn't include
+// the pages of the mapped files, so it's the memory of the heap
+static qint64 CurrentRss(bool anonymous = false)
+{
+#ifdef Q_OS_UNIX
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.count() > 2) {
+            const qint64 pages = fields[1].toLongLong()
+                    - (anonymous ? fields[2].toLongLong() : 0);
+            return pages * sysconf(_SC_PAGESIZE);
+        }
+    }
+#else
+    Q_UNUSED(anonymous);
+#endif
+    return 0;
+}
+
+
+class PhaseReport
+{
+public:
+    PhaseReport()
+    {
+        std::cout << "== Benchmark ==" << std::endl;
+        std::cout << "  " << std::left << std::setw(18) << "Phase"
+                  << std::right << std::setw(10) << "Time, ms"
+                  << std::setw(22) << "Throughput"
+                  << std::setw(10) << "RSS, MB"
+                  << std::setw(12) << "Peak, MB" << std::endl;
+    }
+
+    void start()
+    {
+        m_timer.start();
+    }
+
+    // amount is the number of the processed units per phase
+    void finish(const char *phase, double amount, const char *unit)
+    {
+        const qint64 nsecs = qMax<qint64>(1, m_timer.nsecsElapsed());
+        char throughput[64];
+        snprintf(throughput, sizeof(throughput), "%.1f %s", amount * 1e9 / nsecs, unit);
+        std::cout << "  " << std::left << std::setw(18) << phase
+                  << std::right << std::setw(10) << nsecs / 1000000
+                  << std::setw(22) << throughput
+                  << std::setw(10) << CurrentRss() / (1024 * 1024)
+                  << std::setw(12) << PeakResidentSize() / (1024 * 1024) << std::endl;
+    }
+
+private:
+    QElapsedTimer m_timer;
+};
+
+
+static bool ReadIntOption(const QVariantMap &map, const QString &name, int *value)
+{
+    if (!map.contains(name)) {
+        return true;
+    }
+
+    bool ok = false;
+    *value = map.value(name).toString().toInt(&ok);
+    return ok && *value >= 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QtArgumentParser parser(QCoreApplication::arguments());
+    parser.add("--contacts", QtArgumentParser::String);
+    parser.add("--events", QtArgumentParser::String);
+    parser.add("--text-size", QtArgumentParser::String);
+    parser.add("--seed", QtArgumentParser::String);
+    parser.add("--zero-pages", QtArgumentParser::String);
+    parser.add("--truncate", QtArgumentParser::String);
+    parser.add("--flips", QtArgumentParser::String);
+    parser.add("-j", QtArgumentParser::String);
+    parser.add("--db", QtArgumentParser::String);
+
+    if (!parser.parse()) {
+        std::cout << "cannot parse the arguments: "
+                  << parser.errorString().toStdString()
+                  << std::endl;
+        return -1;
+    }
+
+    const QVariantMap map = parser.result();
+    SyntheticDbOptions dbOptions;
+    int seed = dbOptions.seed;
+    int threadCount = 1;
+    if (!ReadIntOption(map, "--contacts", &dbOptions.contactCount)
+            || !ReadIntOption(map, "--events", &dbOptions.eventsPerContact)
+            || !ReadIntOption(map, "--text-size", &dbOptions.textSize)
+            || !ReadIntOption(map, "--seed", &seed)
+            || !ReadIntOption(map, "--zero-pages", &dbOptions.zeroedPages)
+            || !ReadIntOption(map, "--truncate", &dbOptions.truncatedChains)
+            || !ReadIntOption(map, "--flips", &dbOptions.bitFlips)
+            || !ReadIntOption(map, "-j", &threadCount)
+            || dbOptions.contactCount == 0) {
+        printUsage();
+        return -1;
+    }
+    dbOptions.seed = seed;
+    if (threadCount == 0) {
+        threadCount = QThread::idealThreadCount();
+    }
+
+    const QString dir = QDir::tempPath();
+    const QString dbFileName = map.contains("--db")
+            ? map.value("--db").toString()
+            : QDir(dir).filePath(QString("mirandadbbench-%1.dat").arg(QCoreApplication::applicationPid()));
+    const QString outputFileName = dbFileName + ".out";
+
+    PhaseReport report;
+
+    // generate
+    report.start();
+    SyntheticDbStats stats;
+    const QByteArray db = GenerateSyntheticDb(dbOptions, &stats);
+    report.finish("generate", db.size() / 1048576.0, "MB/s");
+
+    report.start();
+    QFile dbFile(dbFileName);
+    if (!dbFile.open(QIODevice::WriteOnly) || dbFile.write(db) != db.size()) {
+        std::cerr << "can't write file: " << dbFileName.toStdString() << std::endl;
+        return -1;
+    }
+    dbFile.close();
+    report.finish("write", db.size() / 1048576.0, "MB/s");
+
+    MirandaDbImage image;
+    report.start();
+    if (!image.open(dbFileName, true)) {
+        std::cerr << "can't open file for read: " << dbFileName.toStdString() << std::endl;
+        return -1;
+    }
+    report.finish("map", image.size() / 1048576.0, "MB/s");
+
+    const BYTE *firstDataAddr = image.data();
+    const BYTE *lastDataAddr = firstDataAddr + image.size();
+    const DBHeader header = ReadDBHeader(firstDataAddr);
+
+    // the phases of the recovery; the carved records are stored apart, so
+    // the heap of the tables is measured after each of them
+    ScanRange range;
+    range.from = 0;
+    range.to = image.size();
+    const qint64 heapBefore = CurrentRss(true);
+    CarvedRecords carved;
+    report.start();
+    CarveRecords(firstDataAddr, lastDataAddr, QVector<ScanRange>() << range,
+                 threadCount, CarveOptions(), &carved);
+    report.finish("scan", image.size() / 1048576.0, "MB/s");
+    const qint64 carvedHeap = CurrentRss(true) - heapBefore;
+
+    DBRecords records;
+    report.start();
+    StoreRecords(firstDataAddr, &carved, &records);
+    const qint64 recordCount = records.contacts.count() + records.events.count()
+            + records.moduleNames.count() + records.contactSettings.count();
+    report.finish("store", recordCount, "records/s");
+    const qint64 storedHeap = CurrentRss(true) - heapBefore;
+
+    DBRecords walkedRecords;
+    report.start();
+    WalkRecords(firstDataAddr, lastDataAddr, header, threadCount, CarveOptions(), &walkedRecords);
+    report.finish("walk", image.size() / 1048576.0, "MB/s");
+
+    const QVector<DWORD> &contactIds = records.contacts.offsets();
+    const ExtractionSchema schema;
+    const SettingsFilter filter(schema, records.moduleNameTable);
+    report.start();
+    const QVector<ContactSettings> settings = ResolveSettings(firstDataAddr, records, contactIds,
+                                                              threadCount, &filter);
+    report.finish("settings", contactIds.count(), "contacts/s");
+
+    const EventTable &events = records.events;
+    QScopedPointer<QTextDecoder> decoder(QTextCodec::codecForName("CP1251")->makeDecoder());
+    QVector<QString> texts;
+    texts.reserve(events.count());
+    report.start();
+    for (int i = 0; i < events.count(); ++i) {
+        texts.append(DecodeEventText(firstDataAddr, events.at(i), decoder.data()));
+    }
+    report.finish("decode", events.count(), "events/s");
+
+    QFile outputFile(outputFileName);
+    if (!outputFile.open(QIODevice::WriteOnly)) {
+        std::cerr << "can't open file for write: " << outputFileName.toStdString() << std::endl;
+        return -1;
+    }
+    report.start();
+    {
+        JsonWriter writer(&outputFile);
+        writer.beginArray();
+        for (int i = 0; i < events.count(); ++i) {
+            writer.beginObject();
+            writer.writeKey("id");
+            writer.writeNumber(events.offset(i));
+            writer.writeKey("next_id");
+            writer.writeNumber(events.ofsNext(i));
+            writer.writeKey("prev_id");
+            writer.writeNumber(events.ofsPrev(i));
+            writer.writeKey("text");
+            writer.writeString(texts[i]);
+            writer.writeKey("timestamp");
+            writer.writeNumber(events.timestamp(i));
+            writer.endObject();
+        }
+        writer.endArray();
+        writer.flush();
+    }
+    outputFile.close();
+    report.finish("serialize", QFileInfo(outputFileName).size() / 1048576.0, "MB/s");
+    Q_UNUSED(settings);
+
+    // the whole recovery in each output format
+    const Miranda2JsonOptions::OutputFormat formats[] = {
+        Miranda2JsonOptions::JsonFormat,
+        Miranda2JsonOptions::NdjsonFormat,
+        Miranda2JsonOptions::BinaryFormat
+    };
+    const char *const formatNames[] = { "recover json", "recover ndjson", "recover bin" };
+    for (int i = 0; i < 3; ++i) {
+        Miranda2JsonOptions options;
+        options.mapInput = true;
+        options.threadCount = threadCount;
+        options.outputFormat = formats[i];
+        report.start();
+        if (!miranda2json(dbFileName, outputFileName, options)) {
+            return -1;
+        }
+        report.finish(formatNames[i], image.size() / 1048576.0, "MB/s");
+    }
+
+    std::cout << "== Database ==" << std::endl;
+    std::cout << "  Size             : " << db.size() << std::endl;
+    std::cout << "  DBContact        : " << stats.contactCount << " (found " << records.contacts.count() << ")" << std::endl;
+    std::cout << "  DBEvent          : " << stats.eventCount << " (found " << records.events.count() << ")" << std::endl;
+    std::cout << "  DBContactSettings: " << stats.settingsCount << " (found " << records.contactSettings.count() << ")" << std::endl;
+    std::cout << "  DBModuleName     : " << stats.moduleNameCount << " (found " << records.moduleNames.count() << ")" << std::endl;
+    std::cout << "  Text bytes       : " << stats.textBytes << std::endl;
+    std::cout << "  Records heap     : " << carvedHeap / (1024 * 1024) << " MB carved, "
+              << storedHeap / (1024 * 1024) << " MB stored ("
+              << storedHeap / qMax<qint64>(1, recordCount) << " bytes per record)" << std::endl;
+    std::cout << "  Scanner          : " << RecordSignatureScannerName() << std::endl;
+    std::cout << "  Text sanitizer   : " << TextSanitizerName() << std::endl;
+    std::cout << "  Threads          : " << threadCount << std::endl;
+
+    image.close();
+    QFile::remove(outputFileName);
+    if (!map.contains("--db")) {
+        QFile::remove(dbFileName);
+    }
+
+    return 0;
+}
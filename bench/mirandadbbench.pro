@@ -0,0 +1,47 @@
+# Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+TEMPLATE        = app
+TARGET          = mirandadbbench
+CONFIG          += console release
+CONFIG          += mirandadbrecovery_nomain
+QT              += core
+QT              -= gui
+
+
+# enable c++11 features
+QMAKE_CXXFLAGS += -std=c++11
+
+
+DESTDIR         = $$PWD/../bin
+OBJECTS_DIR     = build/obj
+MOC_DIR         = build/moc
+
+
+HEADERS        +=                                                       \
+    $$PWD/syntheticdb.h                                                 \
+
+
+SOURCES        +=                                                       \
+    $$PWD/main.cpp                                                      \
+    $$PWD/syntheticdb.cpp                                               \
+
+
+# the sources of the application without its main()
+include($$PWD/../mirandadbrecovery-sources.pri)
+
+
+# the 3rd libraries (.pri)
+include($$PWD/../submodules/QtArgumentParser/qtargumentparser.pri)
+include($$PWD/../submodules/qt-json/qt-json.pri)
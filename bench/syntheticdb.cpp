@@ -0,0 +1,284 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "syntheticdb.h"
+#include "mirandadb.h"
+#include <QVector>
+#include <cstring>
+
+
+static const int PAGE_SIZE = 4096;
+static const DWORD DB_VERSION = 0x00000700;
+static const char *const MODULE_NAMES[] = {
+    "ICQ", "JABBER", "VKontakte", "MSN", "CList", "Protocol", "SRMsg"
+};
+static const int MODULE_COUNT = sizeof(MODULE_NAMES) / sizeof(MODULE_NAMES[0]);
+static const int EVENT_MODULE = 0;      // ICQ
+
+
+// xorshift32, the generator must not depend on the platform
+class Random
+{
+public:
+    explicit Random(quint32 seed) : m_state(seed ? seed : 1) {}
+
+    quint32 next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    int bounded(int max)
+    {
+        return max > 0 ? next() % max : 0;
+    }
+
+private:
+    quint32 m_state;
+};
+
+
+static void PutByte(QByteArray *db, BYTE value)
+{
+    db->append(static_cast<char>(value));
+}
+
+
+static void PutWord(QByteArray *db, WORD value)
+{
+    PutByte(db, value & 0xFF);
+    PutByte(db, value >> 8);
+}
+
+
+static void PutDWord(QByteArray *db, DWORD value)
+{
+    PutWord(db, value & 0xFFFF);
+    PutWord(db, value >> 16);
+}
+
+
+static void SetDWord(QByteArray *db, DWORD offset, DWORD value)
+{
+    for (int i = 0; i < 4; ++i) {
+        (*db)[offset + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+
+static void PutSetting(QByteArray *blob, const char *name, BYTE type,
+                       const QByteArray &value)
+{
+    PutByte(blob, strlen(name));
+    blob->append(name);
+    PutByte(blob, type);
+    if (type == DBVT_ASCIIZ || type == DBVT_UTF8 || type == DBVT_BLOB) {
+        PutWord(blob, value.size());
+    }
+    blob->append(value);
+}
+
+
+static QByteArray DWordValue(DWORD value)
+{
+    QByteArray result;
+    PutDWord(&result, value);
+    return result;
+}
+
+
+// the words of the latin letters, the cp1251 or utf-8 cyrillic letters
+static QByteArray RandomText(Random *random, int size, DWORD *flags)
+{
+    const int kind = random->bounded(10);
+    QByteArray text;
+    while (text.size() < size) {
+        const int wordSize = 1 + random->bounded(10);
+        for (int i = 0; i < wordSize; ++i) {
+            if (kind < 6) {
+                text.append(static_cast<char>('a' + random->bounded(26)));
+            }
+            else if (kind < 8) {
+                text.append(static_cast<char>(0xE0 + random->bounded(32)));
+            }
+            else {
+                // U+0430..U+044F
+                const int ch = 0x430 + random->bounded(32);
+                text.append(static_cast<char>(0xC0 | (ch >> 6)));
+                text.append(static_cast<char>(0x80 | (ch & 0x3F)));
+            }
+        }
+        text.append(random->bounded(20) ? ' ' : '\n');
+    }
+    text.append('\0');
+
+    *flags = (kind >= 8) ? DBEF_UTF : 0;
+    return text;
+}
+
+
+static DWORD PutContact(QByteArray *db, DWORD ofsFirstSettings)
+{
+    const DWORD offset = db->size();
+    PutDWord(db, DBCONTACT_SIGNATURE);
+    PutDWord(db, 0);                    // ofsNext
+    PutDWord(db, ofsFirstSettings);
+    PutDWord(db, 0);                    // eventCount
+    PutDWord(db, 0);                    // ofsFirstEvent
+    PutDWord(db, 0);                    // ofsLastEvent
+    PutDWord(db, 0);                    // ofsFirstUnreadEvent
+    PutDWord(db, 0);                    // timestampFirstUnread
+    return offset;
+}
+
+
+static DWORD PutContactSettings(QByteArray *db, DWORD ofsModuleName,
+                                const QByteArray &blob)
+{
+    const DWORD offset = db->size();
+    PutDWord(db, DBCONTACTSETTINGS_SIGNATURE);
+    PutDWord(db, 0);                    // ofsNext
+    PutDWord(db, ofsModuleName);
+    PutDWord(db, blob.size() + 1);
+    db->append(blob);
+    PutByte(db, 0);                     // the end of the settings
+    return offset;
+}
+
+
+QByteArray GenerateSyntheticDb(const SyntheticDbOptions &options,
+                               SyntheticDbStats *stats)
+{
+    Random random(options.seed);
+    SyntheticDbStats result;
+    QByteArray db;
+
+    // the header is filled at the end
+    db.append(DBHEADER_SIGNATURE);
+    db.append('\0');
+    db.append(static_cast<char>(26));
+    db.append(QByteArray(7 * sizeof(DWORD), '\0'));
+
+    QVector<DWORD> moduleNames;
+    for (int i = 0; i < MODULE_COUNT; ++i) {
+        if (!moduleNames.isEmpty()) {
+            SetDWord(&db, moduleNames.last() + 4, db.size());
+        }
+        moduleNames.append(db.size());
+        PutDWord(&db, DBMODULENAME_SIGNATURE);
+        PutDWord(&db, 0);
+        PutByte(&db, strlen(MODULE_NAMES[i]));
+        db.append(MODULE_NAMES[i]);
+    }
+    result.moduleNameCount = moduleNames.count();
+
+    // the user and the contacts, each contact has the settings of two
+    // modules: the protocol and the contact list
+    QVector<DWORD> contacts;
+    for (int i = 0; i <= options.contactCount; ++i) {
+        QByteArray protocol;
+        PutSetting(&protocol, "uin", DBVT_DWORD, DWordValue(100000 + random.bounded(900000000)));
+        PutSetting(&protocol, "Nick", DBVT_ASCIIZ, QByteArray("contact") + QByteArray::number(i));
+        PutSetting(&protocol, "FirstName", DBVT_UTF8, "\xd0\x98\xd0\xbc\xd1\x8f");
+        PutSetting(&protocol, "Status", DBVT_WORD, QByteArray("\x28\x00", 2));
+        QByteArray contactList;
+        PutSetting(&contactList, "Group", DBVT_ASCIIZ, "Friends");
+        PutSetting(&contactList, "Hidden", DBVT_BYTE, QByteArray(1, '\0'));
+
+        const DWORD first = PutContactSettings(&db, moduleNames[EVENT_MODULE], protocol);
+        const DWORD second = PutContactSettings(&db, moduleNames[4], contactList);
+        SetDWord(&db, first + 4, second);
+        result.settingsCount += 2;
+
+        if (i > 1) {
+            SetDWord(&db, contacts.last() + 4, db.size());
+        }
+        contacts.append(PutContact(&db, first));
+    }
+    result.contactCount = contacts.count();
+
+    // the events are appended in time, so the chains are interleaved
+    QVector<DWORD> lastEvents(contacts.count(), 0);
+    QVector<DWORD> eventCounts(contacts.count(), 0);
+    QVector<DWORD> events;
+    DWORD timestamp = 1262304000;   // 2010-01-01
+    const qint64 eventCount = static_cast<qint64>(options.contactCount) * options.eventsPerContact;
+    for (qint64 i = 0; i < eventCount; ++i) {
+        const int contact = 1 + random.bounded(options.contactCount);
+        DWORD flags = random.bounded(2) ? DBEF_SENT : DBEF_READ;
+        DWORD textFlags = 0;
+        const QByteArray text = RandomText(&random, 1 + random.bounded(2 * options.textSize),
+                                           &textFlags);
+        timestamp += 1 + random.bounded(600);
+
+        const DWORD offset = db.size();
+        PutDWord(&db, DBEVENT_SIGNATURE);
+        PutDWord(&db, lastEvents[contact]);
+        PutDWord(&db, 0);                       // ofsNext
+        PutDWord(&db, moduleNames[EVENT_MODULE]);
+        PutDWord(&db, timestamp);
+        PutDWord(&db, flags | textFlags);
+        PutWord(&db, 0);                        // EVENTTYPE_MESSAGE
+        PutDWord(&db, text.size());
+        db.append(text);
+
+        if (lastEvents[contact]) {
+            SetDWord(&db, lastEvents[contact] + 8, offset);
+        }
+        else {
+            SetDWord(&db, contacts[contact] + 16, offset);
+        }
+        lastEvents[contact] = offset;
+        ++eventCounts[contact];
+        events.append(offset);
+        result.textBytes += text.size();
+    }
+    result.eventCount = events.count();
+
+    for (int i = 0; i < contacts.count(); ++i) {
+        SetDWord(&db, contacts[i] + 12, eventCounts[i]);
+        SetDWord(&db, contacts[i] + 20, lastEvents[i]);
+    }
+
+    // the header
+    DWORD offset = 16;
+    SetDWord(&db, offset, DB_VERSION);
+    SetDWord(&db, offset + 4, db.size());                   // ofsFileEnd
+    SetDWord(&db, offset + 12, options.contactCount);
+    SetDWord(&db, offset + 16, contacts.count() > 1 ? contacts[1] : 0);
+    SetDWord(&db, offset + 20, contacts[0]);
+    SetDWord(&db, offset + 24, moduleNames[0]);
+
+    // the corruption, the header page stays valid
+    for (int i = 0; i < options.zeroedPages && db.size() > PAGE_SIZE; ++i) {
+        const int page = 1 + random.bounded(db.size() / PAGE_SIZE - 1);
+        const int size = qMin(PAGE_SIZE, db.size() - page * PAGE_SIZE);
+        memset(db.data() + page * PAGE_SIZE, 0, size);
+    }
+    for (int i = 0; i < options.truncatedChains && !events.isEmpty(); ++i) {
+        SetDWord(&db, events[random.bounded(events.count())] + 8, 0);
+    }
+    for (int i = 0; i < options.bitFlips && db.size() > PAGE_SIZE; ++i) {
+        const int pos = PAGE_SIZE + random.bounded(db.size() - PAGE_SIZE);
+        db[pos] = db[pos] ^ static_cast<char>(1 << random.bounded(8));
+    }
+
+    if (stats) {
+        *stats = result;
+    }
+
+    return db;
+}
@@ -0,0 +1,62 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef SYNTHETICDB_H
+#define SYNTHETICDB_H
+
+
+#include <QByteArray>
+#include <QtGlobal>
+
+
+struct SyntheticDbOptions {
+    SyntheticDbOptions()
+        : contactCount(1000), eventsPerContact(100), textSize(200),
+          seed(1), zeroedPages(0), truncatedChains(0), bitFlips(0) {}
+
+    int contactCount;
+    int eventsPerContact;
+    int textSize;           // the average size of the event text
+    quint32 seed;
+    // the corruption
+    int zeroedPages;        // 4KB pages filled by zero
+    int truncatedChains;    // event chains cut in the middle
+    int bitFlips;           // random bits flipped
+};
+
+
+struct SyntheticDbStats {
+    SyntheticDbStats()
+        : contactCount(0), eventCount(0), settingsCount(0),
+          moduleNameCount(0), textBytes(0) {}
+
+    qint64 contactCount;
+    qint64 eventCount;
+    qint64 settingsCount;
+    qint64 moduleNameCount;
+    qint64 textBytes;
+};
+
+
+// Generates the valid miranda database: the header, the chain of the
+// module names, the user and the contacts with their settings and the
+// chains of the events. The events of the contacts are interleaved as
+// in the real database which grows in time. The texts are ascii, cp1251
+// and utf-8. Then the corruption is injected. The same options give
+// the same database
+QByteArray GenerateSyntheticDb(const SyntheticDbOptions &options,
+                               SyntheticDbStats *stats = 0);
+
+
+#endif // SYNTHETICDB_H
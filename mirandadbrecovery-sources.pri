@@ -3,11 +3,74 @@ INCLUDEPATH    +=                                                       \
 
 
 HEADERS        +=                                                       \
-    $$PWD/src/miranda.h
+    $$PWD/src/batchrecovery.h                                           \
+    $$PWD/src/binaryformat.h                                            \
+    $$PWD/src/binaryoutput.h                                            \
+    $$PWD/src/binaryreader.h                                            \
+    $$PWD/src/binarywriter.h                                            \
+    $$PWD/src/chainwalker.h                                             \
+    $$PWD/src/compressedfile.h                                          \
+    $$PWD/src/contactsettings.h                                         \
+    $$PWD/src/eventtext.h                                               \
+    $$PWD/src/extractionschema.h                                        \
+    $$PWD/src/fasthash.h                                                \
+    $$PWD/src/imagerecovery.h                                           \
+    $$PWD/src/imagesource.h                                             \
+    $$PWD/src/jsonoutput.h                                              \
+    $$PWD/src/jsonwriter.h                                              \
+    $$PWD/src/miranda.h                                                 \
+    $$PWD/src/mirandadb.h                                               \
+    $$PWD/src/mirandadbimage.h                                          \
+    $$PWD/src/modulenametable.h                                         \
+    $$PWD/src/progress.h                                                \
+    $$PWD/src/recordcarver.h                                            \
+    $$PWD/src/recorddedup.h                                             \
+    $$PWD/src/recordfilter.h                                            \
+    $$PWD/src/recordindex.h                                             \
+    $$PWD/src/recordtable.h                                             \
+    $$PWD/src/recordvalidator.h                                         \
+    $$PWD/src/recoverystats.h                                           \
+    $$PWD/src/recoveryvisitor.h                                         \
+    $$PWD/src/scanindex.h                                               \
+    $$PWD/src/shardedoutput.h                                           \
+    $$PWD/src/signaturescanner.h                                        \
+    $$PWD/src/textindex.h                                               \
+    $$PWD/src/textsanitizer.h                                           \
 
 
 SOURCES        +=                                                       \
-    $$PWD/src/miranda.cpp
+    $$PWD/src/batchrecovery.cpp                                         \
+    $$PWD/src/binaryoutput.cpp                                          \
+    $$PWD/src/binaryreader.cpp                                          \
+    $$PWD/src/binarywriter.cpp                                          \
+    $$PWD/src/chainwalker.cpp                                           \
+    $$PWD/src/compressedfile.cpp                                        \
+    $$PWD/src/contactsettings.cpp                                       \
+    $$PWD/src/eventtext.cpp                                             \
+    $$PWD/src/extractionschema.cpp                                      \
+    $$PWD/src/fasthash.cpp                                              \
+    $$PWD/src/imagerecovery.cpp                                         \
+    $$PWD/src/imagesource.cpp                                           \
+    $$PWD/src/jsonoutput.cpp                                            \
+    $$PWD/src/jsonwriter.cpp                                            \
+    $$PWD/src/miranda.cpp                                               \
+    $$PWD/src/mirandadb.cpp                                             \
+    $$PWD/src/mirandadbimage.cpp                                        \
+    $$PWD/src/modulenametable.cpp                                       \
+    $$PWD/src/progress.cpp                                              \
+    $$PWD/src/recordcarver.cpp                                          \
+    $$PWD/src/recorddedup.cpp                                           \
+    $$PWD/src/recordfilter.cpp                                          \
+    $$PWD/src/recordindex.cpp                                           \
+    $$PWD/src/recordtable.cpp                                           \
+    $$PWD/src/recordvalidator.cpp                                       \
+    $$PWD/src/recoverystats.cpp                                         \
+    $$PWD/src/recoveryvisitor.cpp                                       \
+    $$PWD/src/scanindex.cpp                                             \
+    $$PWD/src/shardedoutput.cpp                                         \
+    $$PWD/src/signaturescanner.cpp                                      \
+    $$PWD/src/textindex.cpp                                             \
+    $$PWD/src/textsanitizer.cpp                                         \
 
 
 FORMS          +=                                                       \
@@ -28,7 +91,17 @@ OTHER_FILES    +=                                                       \
     $$PWD/README.md                                                     \
 
 
-!contains(QT, testlib) {
+# the output compression: zlib is always linked, zstd if pkg-config
+# finds it. The users of the static library link them too
+LIBS           += -lz
+packagesExist(libzstd) {
+    CONFIG     += link_pkgconfig
+    PKGCONFIG  += libzstd
+    DEFINES    += HAVE_ZSTD
+}
+
+
+!contains(QT, testlib):!contains(CONFIG, mirandadbrecovery_nomain) {
     HEADERS   +=                                                        \
 
     SOURCES   +=                                                        \
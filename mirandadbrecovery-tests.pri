@@ -1,6 +1,19 @@
 contains(QT, testlib) {
+    INCLUDEPATH +=                                      \
+        $$PWD/bench                                     \
+        $$PWD/tests                                     \
+
     SOURCES   +=                                        \
+        $$PWD/bench/syntheticdb.cpp                     \
+        $$PWD/tests/main.cpp                            \
+        $$PWD/tests/tst_recordcarver.cpp                \
+        $$PWD/tests/tst_signaturescanner.cpp            \
+        $$PWD/tests/tst_textsanitizer.cpp               \
 
     HEADERS   +=                                        \
+        $$PWD/bench/syntheticdb.h                       \
+        $$PWD/tests/tst_recordcarver.h                  \
+        $$PWD/tests/tst_signaturescanner.h              \
+        $$PWD/tests/tst_textsanitizer.h                 \
 
 }
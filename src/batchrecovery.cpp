@@ -0,0 +1,246 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "batchrecovery.h"
+#include "progress.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <algorithm>
+#include <iostream>
+
+
+class BatchScheduler
+{
+public:
+    BatchScheduler(QVector<BatchJob> *jobs, int workerCount);
+    ~BatchScheduler();
+
+    // returns -1 if there are no more jobs
+    int takeJob(int worker);
+    inline int workerCount() const;
+
+private:
+    struct Queue {
+        QMutex mutex;
+        QList<int> jobs;    // sorted by the size of the job, descending
+    };
+
+    QVector<Queue *> m_queues;
+};
+
+int BatchScheduler::workerCount() const
+{
+    return m_queues.count();
+}
+
+
+class BatchWorker : public QRunnable
+{
+public:
+    BatchWorker(BatchScheduler *scheduler, int worker, BatchJob *jobs,
+                const Miranda2JsonOptions &options)
+        : m_scheduler(scheduler), m_worker(worker), m_jobs(jobs),
+          m_options(options)
+    {
+    }
+
+    void run()
+    {
+        int index;
+        while ((index = m_scheduler->takeJob(m_worker)) != -1) {
+            // the interrupted batch doesn't start the rest of the jobs
+            if (IsStopRequested()) {
+                break;
+            }
+
+            BatchJob &job = m_jobs[index];
+
+            QElapsedTimer timer;
+            timer.start();
+            job.success = miranda2json(job.inputFileName, job.outputFileName, m_options);
+            job.elapsed = timer.elapsed();
+        }
+    }
+
+private:
+    BatchScheduler *m_scheduler;
+    int m_worker;
+    BatchJob *m_jobs;
+    Miranda2JsonOptions m_options;
+};
+
+
+static bool BatchJobGreaterThan(const BatchJob &a, const BatchJob &b)
+{
+    return a.size > b.size;
+}
+
+
+BatchScheduler::BatchScheduler(QVector<BatchJob> *jobs, int workerCount)
+{
+    for (int i = 0; i < workerCount; ++i) {
+        m_queues.append(new Queue);
+    }
+
+    // the jobs are sorted, so each worker begins with the largest of
+    // its jobs and one huge database doesn't run alone at the end
+    for (int i = 0; i < jobs->count(); ++i) {
+        m_queues[i % workerCount]->jobs.append(i);
+    }
+}
+
+BatchScheduler::~BatchScheduler()
+{
+    qDeleteAll(m_queues);
+}
+
+int BatchScheduler::takeJob(int worker)
+{
+    for (int i = 0; i < m_queues.count(); ++i) {
+        Queue *queue = m_queues[(worker + i) % m_queues.count()];
+        QMutexLocker locker(&queue->mutex);
+        if (!queue->jobs.isEmpty()) {
+            return queue->jobs.takeFirst();
+        }
+    }
+
+    return -1;
+}
+
+
+bool ReadBatchManifest(const QString &manifestFileName, QVector<BatchJob> *jobs)
+{
+    QFile file(manifestFileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        std::cerr << "can't open file for read: " << manifestFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith("#")) {
+            continue;
+        }
+
+        const QStringList fields = line.split('\t');
+        if (fields.count() != 2) {
+            std::cerr << "invalid manifest line " << lineNumber << ": "
+                      << line.toStdString() << std::endl;
+            return false;
+        }
+
+        BatchJob job;
+        job.inputFileName = fields.at(0);
+        job.outputFileName = fields.at(1);
+        job.size = QFileInfo(job.inputFileName).size();
+        jobs->append(job);
+    }
+
+    return true;
+}
+
+
+bool ReadBatchDirectory(const QString &dirName, const QString &outputDirName,
+                        const QString &suffix, QVector<BatchJob> *jobs)
+{
+    const QDir dir(dirName);
+    if (!dir.exists()) {
+        std::cerr << "directory doesn't exist: " << dirName.toStdString() << std::endl;
+        return false;
+    }
+
+    const QDir outputDir(outputDirName);
+    if (!outputDir.mkpath(".")) {
+        std::cerr << "can't create directory: " << outputDirName.toStdString() << std::endl;
+        return false;
+    }
+
+    // the outputs of the previous runs may be inside the input directory
+    const QString outputPrefix = QFileInfo(outputDirName).absoluteFilePath() + "/";
+    QStringList fileNames;
+    QDirIterator it(dir.path(), QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString fileName = it.next();
+        if (!QFileInfo(fileName).absoluteFilePath().startsWith(outputPrefix)) {
+            fileNames.append(fileName);
+        }
+    }
+    // the order of the iterator is undefined, the numbered names below
+    // must be the same on each run
+    fileNames.sort();
+
+    // the subdirectories are mirrored in the output directory, the inputs
+    // of the same directory with the same base name ("history.dat" and
+    // "history.db") get the numbered outputs
+    QSet<QString> outputNames;
+    foreach (const QString &fileName, fileNames) {
+        const QFileInfo info(fileName);
+        const QString relativeDir = QFileInfo(dir.relativeFilePath(fileName)).path();
+        QString baseName = info.completeBaseName();
+        if (relativeDir != ".") {
+            baseName = relativeDir + "/" + baseName;
+        }
+
+        QString outputName = baseName + suffix;
+        for (int n = 2; outputNames.contains(outputName); ++n) {
+            outputName = baseName + "-" + QString::number(n) + suffix;
+        }
+        outputNames.insert(outputName);
+
+        if (relativeDir != "." && !outputDir.mkpath(relativeDir)) {
+            std::cerr << "can't create directory: "
+                      << outputDir.filePath(relativeDir).toStdString() << std::endl;
+            return false;
+        }
+
+        BatchJob job;
+        job.inputFileName = fileName;
+        job.outputFileName = outputDir.filePath(outputName);
+        job.size = info.size();
+        jobs->append(job);
+    }
+
+    return true;
+}
+
+
+void RunBatch(QVector<BatchJob> *jobs, const Miranda2JsonOptions &options,
+              int workerCount)
+{
+    std::stable_sort(jobs->begin(), jobs->end(), BatchJobGreaterThan);
+
+    workerCount = qMax(1, qMin(workerCount, jobs->count()));
+    BatchScheduler scheduler(jobs, workerCount);
+
+    // each job is taken by the one worker, so the workers write the
+    // results without the synchronization
+    QThreadPool pool;
+    pool.setMaxThreadCount(workerCount);
+    for (int i = 0; i < workerCount; ++i) {
+        pool.start(new BatchWorker(&scheduler, i, jobs->data(), options));
+    }
+    pool.waitForDone();
+}
@@ -0,0 +1,52 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef BATCHRECOVERY_H
+#define BATCHRECOVERY_H
+
+
+#include "miranda.h"
+#include <QString>
+#include <QVector>
+
+
+struct BatchJob {
+    BatchJob() : size(0), success(false), elapsed(0) {}
+
+    QString inputFileName;
+    QString outputFileName;
+    qint64 size;        // size of the input, the largest jobs go first
+    bool success;
+    qint64 elapsed;     // msecs
+};
+
+
+// Reads the manifest of the jobs, each line is "input<TAB>output",
+// the empty lines and the lines beginning with '#' are skipped
+bool ReadBatchManifest(const QString &manifestFileName, QVector<BatchJob> *jobs);
+
+// Makes the job for each file of the directory and its subdirectories,
+// the output files are placed into the same subdirectories of the
+// outputDirName with the suffix instead of the extension
+bool ReadBatchDirectory(const QString &dirName, const QString &outputDirName,
+                        const QString &suffix, QVector<BatchJob> *jobs);
+
+// Recovers the databases by workerCount threads. Each worker has its own
+// queue of the jobs, the worker which has no more jobs steals the
+// largest job from the queue of the other worker
+void RunBatch(QVector<BatchJob> *jobs, const Miranda2JsonOptions &options,
+              int workerCount);
+
+
+#endif // BATCHRECOVERY_H
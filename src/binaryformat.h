@@ -0,0 +1,83 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef BINARYFORMAT_H
+#define BINARYFORMAT_H
+
+
+#include <QtGlobal>
+
+
+// The binary columnar output. All numbers are little-endian:
+//   magic[8], version, columnCount, userContactId, reserved
+//   columnCount * (column, elementSize, offset (64-bit), count (64-bit))
+//   the data of the columns, each column is aligned by 8 bytes
+// The fixed-width column is the array of count elements. The string
+// column (elementSize is 0) is the array of count 64-bit offsets
+// relative to the begin of the column followed by the strings, each
+// string is the 32-bit length and the utf-8 bytes
+static const char BINARY_MAGIC[] = "MDBRCOL1";
+static const int BINARY_MAGIC_SIZE = 8;
+static const quint32 BINARY_VERSION = 1;
+static const int BINARY_HEADER_SIZE = BINARY_MAGIC_SIZE + 4 * 4;
+static const int BINARY_COLUMN_INFO_SIZE = 4 + 4 + 8 + 8;
+static const int BINARY_ALIGNMENT = 8;
+
+
+enum BinaryColumn {
+    // the module names, the row is the module id
+    ModuleNameColumn,
+    // the contacts
+    ContactIdColumn,
+    ContactEventCountColumn,
+    ContactFirstEventColumn,
+    ContactFirstUnreadEventColumn,
+    ContactLastEventColumn,
+    // the settings, sorted by the contact, the module and the name
+    SettingContactColumn,       // the row of the contact
+    SettingModuleColumn,        // the module id
+    SettingTypeColumn,          // see BinarySettingType
+    SettingNameColumn,
+    SettingNumberColumn,        // the value of the number setting
+    SettingStringColumn,        // the value of the string or blob setting
+    // the message events
+    EventIdColumn,
+    EventPrevColumn,
+    EventNextColumn,
+    EventTimestampColumn,
+    EventFlagsColumn,
+    EventTypeColumn,
+    EventModuleColumn,          // the module id
+    EventTextColumn,
+    BinaryColumnCount
+};
+
+
+enum BinarySettingType {
+    NumberSetting,
+    StringSetting,
+    BlobSetting
+};
+
+
+// the size of the element of the column, 0 for the string column
+static const int BINARY_ELEMENT_SIZE[BinaryColumnCount] = {
+    0,
+    4, 4, 4, 4, 4,
+    4, 2, 1, 0, 8, 0,
+    4, 4, 4, 4, 4, 2, 2, 0
+};
+
+
+#endif // BINARYFORMAT_H
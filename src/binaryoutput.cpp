@@ -0,0 +1,117 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "binaryoutput.h"
+#include <QFile>
+#include <iostream>
+
+
+BinaryOutputVisitor::BinaryOutputVisitor(const QString &fileName)
+    : m_fileName(fileName), m_contactCount(0)
+{
+}
+
+
+void BinaryOutputVisitor::onBegin(const DBHeader &header)
+{
+    m_writer.setUserContactId(header.ofsUser);
+}
+
+
+void BinaryOutputVisitor::onModule(WORD id, const QString &name)
+{
+    m_writer.appendString(ModuleNameColumn, name.toUtf8());
+    if (!m_moduleIds.contains(name)) {
+        m_moduleIds.insert(name, id);
+    }
+}
+
+
+void BinaryOutputVisitor::onContact(DWORD id, const DBContact &contact)
+{
+    m_writer.appendNumber(ContactIdColumn, id);
+    m_writer.appendNumber(ContactEventCountColumn, contact.eventCount);
+    m_writer.appendNumber(ContactFirstEventColumn, contact.ofsFirstEvent);
+    m_writer.appendNumber(ContactFirstUnreadEventColumn, contact.ofsFirstUnreadEvent);
+    m_writer.appendNumber(ContactLastEventColumn, contact.ofsLastEvent);
+    ++m_contactCount;
+}
+
+
+void BinaryOutputVisitor::onSettings(DWORD /* contactId */, const ContactSettings &settings)
+{
+    // the settings refer to the row of the last contact
+    const quint32 row = m_contactCount - 1;
+
+    ContactSettings::const_iterator moduleIt;
+    for (moduleIt = settings.constBegin(); moduleIt != settings.constEnd(); ++moduleIt) {
+        ModuleSettings::const_iterator it;
+        for (it = moduleIt.value().constBegin(); it != moduleIt.value().constEnd(); ++it) {
+            m_writer.appendNumber(SettingContactColumn, row);
+            m_writer.appendNumber(SettingModuleColumn, m_moduleIds.value(moduleIt.key()));
+            m_writer.appendString(SettingNameColumn, it.key().toUtf8());
+            switch (it.value().type()) {
+            case QVariant::String:
+                m_writer.appendNumber(SettingTypeColumn, StringSetting);
+                m_writer.appendNumber(SettingNumberColumn, 0);
+                m_writer.appendString(SettingStringColumn, it.value().toString().toUtf8());
+                break;
+            case QVariant::ByteArray:
+                m_writer.appendNumber(SettingTypeColumn, BlobSetting);
+                m_writer.appendNumber(SettingNumberColumn, 0);
+                m_writer.appendString(SettingStringColumn, it.value().toByteArray());
+                break;
+            default:
+                m_writer.appendNumber(SettingTypeColumn, NumberSetting);
+                m_writer.appendNumber(SettingNumberColumn, it.value().toLongLong());
+                m_writer.appendString(SettingStringColumn, QByteArray());
+                break;
+            }
+        }
+    }
+}
+
+
+void BinaryOutputVisitor::onEvent(const EventView &event)
+{
+    if (!event.isMessage()) {
+        return;
+    }
+
+    const DBEvent &dbEvent = event.event();
+    m_writer.appendNumber(EventIdColumn, event.id());
+    m_writer.appendNumber(EventPrevColumn, dbEvent.ofsPrev);
+    m_writer.appendNumber(EventNextColumn, dbEvent.ofsNext);
+    m_writer.appendNumber(EventTimestampColumn, dbEvent.timestamp);
+    m_writer.appendNumber(EventFlagsColumn, dbEvent.flags);
+    m_writer.appendNumber(EventTypeColumn, dbEvent.eventType);
+    m_writer.appendNumber(EventModuleColumn, dbEvent.moduleId);
+    m_writer.appendString(EventTextColumn, event.text().toUtf8());
+}
+
+
+bool BinaryOutputVisitor::onEnd()
+{
+    QFile outputFile(m_fileName);
+    if (!outputFile.open(QIODevice::WriteOnly)) {
+        std::cerr << "can't open file for write: " << m_fileName.toStdString() << std::endl;
+        return false;
+    }
+    if (!m_writer.write(&outputFile)) {
+        std::cerr << "can't write file: " << m_fileName.toStdString() << std::endl;
+        return false;
+    }
+
+    return true;
+}
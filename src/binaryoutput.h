@@ -0,0 +1,49 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef BINARYOUTPUT_H
+#define BINARYOUTPUT_H
+
+
+#include "binarywriter.h"
+#include "recoveryvisitor.h"
+#include <QHash>
+#include <QString>
+
+
+// Collects the recovered records with all settings into the columns and
+// writes the binary file at the end, see binaryformat.h
+class BinaryOutputVisitor : public RecoveryVisitor
+{
+public:
+    explicit BinaryOutputVisitor(const QString &fileName);
+
+    void onBegin(const DBHeader &header);
+    void onModule(WORD id, const QString &name);
+    void onContact(DWORD id, const DBContact &contact);
+    void onSettings(DWORD contactId, const ContactSettings &settings);
+    void onEvent(const EventView &event);
+    bool onEnd();
+
+private:
+    QString m_fileName;
+    BinaryWriter m_writer;
+    // the settings refer to the modules by the name, the first id of
+    // the same names is used
+    QHash<QString, WORD> m_moduleIds;
+    quint32 m_contactCount;
+};
+
+
+#endif // BINARYOUTPUT_H
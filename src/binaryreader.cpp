@@ -0,0 +1,158 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "binaryreader.h"
+#include <cstring>
+
+
+static quint64 ReadNumber(const uchar *data, int size)
+{
+    quint64 value = 0;
+    for (int i = size - 1; i >= 0; --i) {
+        value = (value << 8) | data[i];
+    }
+
+    return value;
+}
+
+
+BinaryReader::BinaryReader()
+    : m_map(0), m_data(0), m_size(0), m_userContactId(0)
+{
+}
+
+BinaryReader::~BinaryReader()
+{
+    close();
+}
+
+bool BinaryReader::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    // the file is read into the memory if it can't be mapped
+    const qint64 size = m_file.size();
+    if (size > 0) {
+        m_map = m_file.map(0, size);
+    }
+    if (m_map) {
+        m_data = m_map;
+        m_size = size;
+    }
+    else {
+        m_bytes = m_file.readAll();
+        m_data = (const uchar *)m_bytes.constData();
+        m_size = m_bytes.size();
+    }
+
+    if (!validate()) {
+        m_errorString = "invalid data format";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void BinaryReader::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = 0;
+    }
+
+    m_file.close();
+    m_bytes.clear();
+    m_data = 0;
+    m_size = 0;
+    m_userContactId = 0;
+    m_columns.clear();
+}
+
+quint64 BinaryReader::number(BinaryColumn column, qint64 row) const
+{
+    const int size = BINARY_ELEMENT_SIZE[column];
+    return ReadNumber(m_data + m_columns[column].offset + row * size, size);
+}
+
+QByteArray BinaryReader::string(BinaryColumn column, qint64 row) const
+{
+    const uchar *first = m_data + m_columns[column].offset;
+    const uchar *data = first + ReadNumber(first + row * 8, 8);
+    const int length = ReadNumber(data, 4);
+
+    return QByteArray::fromRawData((const char *)data + 4, length);
+}
+
+bool BinaryReader::validate()
+{
+    if (m_size < BINARY_HEADER_SIZE
+            || memcmp(m_data, BINARY_MAGIC, BINARY_MAGIC_SIZE)
+            || ReadNumber(m_data + BINARY_MAGIC_SIZE, 4) != BINARY_VERSION) {
+        return false;
+    }
+
+    const quint64 columnCount = ReadNumber(m_data + BINARY_MAGIC_SIZE + 4, 4);
+    m_userContactId = ReadNumber(m_data + BINARY_MAGIC_SIZE + 8, 4);
+    if (columnCount != BinaryColumnCount
+            || m_size < BINARY_HEADER_SIZE + BinaryColumnCount * BINARY_COLUMN_INFO_SIZE) {
+        return false;
+    }
+
+    m_columns.resize(BinaryColumnCount);
+    for (int i = 0; i < BinaryColumnCount; ++i) {
+        const uchar *info = m_data + BINARY_HEADER_SIZE + i * BINARY_COLUMN_INFO_SIZE;
+        const quint64 column = ReadNumber(info, 4);
+        const quint64 elementSize = ReadNumber(info + 4, 4);
+        const quint64 offset = ReadNumber(info + 8, 8);
+        const quint64 count = ReadNumber(info + 16, 8);
+        if (column != static_cast<quint64>(i)
+                || elementSize != static_cast<quint64>(BINARY_ELEMENT_SIZE[i])
+                || offset > static_cast<quint64>(m_size)) {
+            return false;
+        }
+
+        // the fixed-width elements and the string offsets lie inside
+        // the file
+        const quint64 rowSize = elementSize ? elementSize : 8;
+        if (count > (m_size - offset) / rowSize) {
+            return false;
+        }
+        m_columns[i].offset = offset;
+        m_columns[i].count = count;
+
+        if (elementSize) {
+            continue;
+        }
+
+        // each string lies inside the file
+        for (quint64 row = 0; row < count; ++row) {
+            const quint64 stringOffset = ReadNumber(m_data + offset + row * 8, 8);
+            if (stringOffset > m_size - offset
+                    || m_size - offset - stringOffset < 4
+                    || ReadNumber(m_data + offset + stringOffset, 4)
+                        > m_size - offset - stringOffset - 4) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
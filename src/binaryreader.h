@@ -0,0 +1,82 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef BINARYREADER_H
+#define BINARYREADER_H
+
+
+#include "binaryformat.h"
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+
+// The reader of the binary output, see binaryformat.h. The file is
+// mapped into the memory, all offsets are validated when the file is
+// opened, so the values are read without the checks
+class BinaryReader
+{
+public:
+    BinaryReader();
+    ~BinaryReader();
+
+    bool open(const QString &fileName);
+    void close();
+
+    inline quint32 userContactId() const;
+    inline qint64 count(BinaryColumn column) const;
+    quint64 number(BinaryColumn column, qint64 row) const;
+    // the string refers to the mapped file, it is valid until close()
+    QByteArray string(BinaryColumn column, qint64 row) const;
+
+    inline const QString &errorString() const;
+
+private:
+    Q_DISABLE_COPY(BinaryReader)
+
+    struct Column {
+        qint64 offset;
+        qint64 count;
+    };
+
+    bool validate();
+
+    QFile m_file;
+    QByteArray m_bytes;
+    uchar *m_map;
+    const uchar *m_data;
+    qint64 m_size;
+    quint32 m_userContactId;
+    QVector<Column> m_columns;
+    QString m_errorString;
+};
+
+quint32 BinaryReader::userContactId() const
+{
+    return m_userContactId;
+}
+
+qint64 BinaryReader::count(BinaryColumn column) const
+{
+    return m_columns[column].count;
+}
+
+const QString &BinaryReader::errorString() const
+{
+    return m_errorString;
+}
+
+
+#endif // BINARYREADER_H
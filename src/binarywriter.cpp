@@ -0,0 +1,154 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "binarywriter.h"
+#include <QIODevice>
+
+
+static const int CHUNK_SIZE = 16 * 1024 * 1024;
+
+
+static void PutNumber(QByteArray *data, quint64 value, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        data->append(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+
+static qint64 AlignedOffset(qint64 offset)
+{
+    return (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+}
+
+
+BinaryWriter::BinaryWriter()
+    : m_userContactId(0), m_columns(BinaryColumnCount)
+{
+}
+
+void BinaryWriter::setUserContactId(quint32 id)
+{
+    m_userContactId = id;
+}
+
+void BinaryWriter::appendNumber(BinaryColumn column, quint64 value)
+{
+    Q_ASSERT(BINARY_ELEMENT_SIZE[column] > 0);
+
+    char data[8];
+    for (int i = 0; i < BINARY_ELEMENT_SIZE[column]; ++i) {
+        data[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+
+    Column *target = &m_columns[column];
+    append(target, data, BINARY_ELEMENT_SIZE[column]);
+    ++target->count;
+}
+
+void BinaryWriter::appendString(BinaryColumn column, const QByteArray &utf8)
+{
+    Q_ASSERT(BINARY_ELEMENT_SIZE[column] == 0);
+
+    Column *target = &m_columns[column];
+    target->offsets.append(target->size);
+
+    char length[4];
+    for (int i = 0; i < 4; ++i) {
+        length[i] = static_cast<char>((utf8.size() >> (8 * i)) & 0xFF);
+    }
+    append(target, length, 4);
+    append(target, utf8.constData(), utf8.size());
+    ++target->count;
+}
+
+bool BinaryWriter::write(QIODevice *device) const
+{
+    QByteArray header(BINARY_MAGIC, BINARY_MAGIC_SIZE);
+    PutNumber(&header, BINARY_VERSION, 4);
+    PutNumber(&header, BinaryColumnCount, 4);
+    PutNumber(&header, m_userContactId, 4);
+    PutNumber(&header, 0, 4);
+
+    // the columns follow the table of the columns
+    qint64 offset = BINARY_HEADER_SIZE + BinaryColumnCount * BINARY_COLUMN_INFO_SIZE;
+    QVector<qint64> offsets(BinaryColumnCount);
+    for (int i = 0; i < BinaryColumnCount; ++i) {
+        offset = AlignedOffset(offset);
+        offsets[i] = offset;
+        PutNumber(&header, i, 4);
+        PutNumber(&header, BINARY_ELEMENT_SIZE[i], 4);
+        PutNumber(&header, offset, 8);
+        PutNumber(&header, m_columns[i].count, 8);
+        offset += columnSize(i);
+    }
+
+    if (device->write(header) != header.size()) {
+        return false;
+    }
+
+    qint64 pos = header.size();
+    for (int i = 0; i < BinaryColumnCount; ++i) {
+        const Column &column = m_columns[i];
+
+        // the string offsets are relative to the begin of the column,
+        // the strings follow the offsets
+        QByteArray prefix(offsets[i] - pos, '\0');
+        const qint64 stringsOffset = column.offsets.count() * Q_INT64_C(8);
+        for (int j = 0; j < column.offsets.count(); ++j) {
+            PutNumber(&prefix, stringsOffset + column.offsets[j], 8);
+            if (prefix.size() >= CHUNK_SIZE) {
+                if (device->write(prefix) != prefix.size()) {
+                    return false;
+                }
+                prefix.clear();
+            }
+        }
+        if (device->write(prefix) != prefix.size()) {
+            return false;
+        }
+
+        for (int j = 0; j < column.chunks.count(); ++j) {
+            if (device->write(column.chunks[j]) != column.chunks[j].size()) {
+                return false;
+            }
+        }
+
+        pos = offsets[i] + columnSize(i);
+    }
+
+    return true;
+}
+
+void BinaryWriter::append(Column *column, const char *data, int size)
+{
+    while (size > 0) {
+        if (column->chunks.isEmpty() || column->chunks.last().size() >= CHUNK_SIZE) {
+            column->chunks.append(QByteArray());
+            column->chunks.last().reserve(CHUNK_SIZE);
+        }
+
+        QByteArray &chunk = column->chunks.last();
+        const int count = qMin(size, CHUNK_SIZE - chunk.size());
+        chunk.append(data, count);
+        column->size += count;
+        data += count;
+        size -= count;
+    }
+}
+
+qint64 BinaryWriter::columnSize(int column) const
+{
+    return m_columns[column].offsets.count() * Q_INT64_C(8) + m_columns[column].size;
+}
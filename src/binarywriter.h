@@ -0,0 +1,60 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef BINARYWRITER_H
+#define BINARYWRITER_H
+
+
+#include "binaryformat.h"
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+class QIODevice;
+
+
+// Collects the columns of the binary output in the memory and writes
+// them at once, see binaryformat.h. The columns are kept in the chunks,
+// so the size of the column isn't limited by the size of QByteArray
+class BinaryWriter
+{
+public:
+    BinaryWriter();
+
+    void setUserContactId(quint32 id);
+
+    // the value is truncated to the element size of the column
+    void appendNumber(BinaryColumn column, quint64 value);
+    void appendString(BinaryColumn column, const QByteArray &utf8);
+
+    bool write(QIODevice *device) const;
+
+private:
+    struct Column {
+        Column() : count(0), size(0) {}
+
+        quint64 count;
+        qint64 size;                // the size of the chunks
+        QList<QByteArray> chunks;
+        QVector<quint64> offsets;   // the string column only
+    };
+
+    void append(Column *column, const char *data, int size);
+    qint64 columnSize(int column) const;
+
+    quint32 m_userContactId;
+    QVector<Column> m_columns;
+};
+
+
+#endif // BINARYWRITER_H
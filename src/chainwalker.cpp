@@ -0,0 +1,387 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "chainwalker.h"
+#include "progress.h"
+#include <QBitArray>
+#include <QHash>
+#include <QSet>
+#include <algorithm>
+
+
+// the size of the smallest record which can be rejected by the filter,
+// the header of DBContactSettings
+static const DWORD SKIPPED_GRANULE_SIZE = 16;
+
+
+class ChainWalker
+{
+public:
+    ChainWalker(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                const RecordFilter *filter);
+
+    void walk(const DBHeader &header);
+    QVector<ScanRange> uncoveredRanges() const;
+    void takeRecords(CarvedRecords *records) const;
+
+private:
+    bool isRecordAt(DWORD offset, DWORD signature) const;
+    void cover(DWORD from, DWORD to);
+    inline bool isSkipped(DWORD offset) const;
+    void skip(DWORD offset);
+
+    void walkModuleNames(DWORD offset);
+    void walkContact(DWORD offset, bool user);
+    void walkSettings(DWORD offset, bool keep);
+    void walkEvents(DWORD offset, bool forward, bool keep);
+
+    const DBModuleName *readModuleName(DWORD offset);
+    const DBContact *readContact(DWORD offset);
+    bool readSettings(DWORD offset, DBContactSettings *settings);
+    bool readEvent(DWORD offset, DBEvent *event);
+
+    const BYTE *m_firstDataAddr;
+    const BYTE *m_lastDataAddr;
+    const RecordFilter *m_filter;
+    QHash<DWORD, DBContact> m_contacts;
+    QHash<DWORD, DBEvent> m_events;
+    QHash<DWORD, DBModuleName> m_moduleNames;
+    QHash<DWORD, DBContactSettings> m_contactSettings;
+    QVector<ScanRange> m_covered;
+    // the settings and the events which were read, but not kept, see
+    // skip()
+    QBitArray m_skipped;
+    CarveCounters m_counters;
+};
+
+
+static bool ScanRangeLessThan(const ScanRange &a, const ScanRange &b)
+{
+    return a.from < b.from;
+}
+
+
+// the hash isn't ordered, so the offsets are sorted and the records are
+// appended in their order
+template <typename T, typename Table>
+static void TakeRecords(const QHash<DWORD, T> &from, Table *to)
+{
+    QVector<DWORD> offsets;
+    offsets.reserve(from.count());
+    typename QHash<DWORD, T>::const_iterator it;
+    for (it = from.constBegin(); it != from.constEnd(); ++it) {
+        offsets.append(it.key());
+    }
+    std::sort(offsets.begin(), offsets.end());
+
+    to->reserve(offsets.count());
+    for (int i = 0; i < offsets.count(); ++i) {
+        to->append(offsets.at(i), from.value(offsets.at(i)));
+    }
+}
+
+
+ChainWalker::ChainWalker(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                         const RecordFilter *filter)
+    : m_firstDataAddr(firstDataAddr), m_lastDataAddr(lastDataAddr), m_filter(filter)
+{
+}
+
+void ChainWalker::walk(const DBHeader &header)
+{
+    cover(0, sizeof(DBHeader));
+
+    walkModuleNames(header.ofsFirstModuleName);
+
+    walkContact(header.ofsUser, true);
+
+    // the broken chain may be looped
+    QSet<DWORD> visited;
+    DWORD offset = header.ofsFirstContact;
+    while (offset && !visited.contains(offset)) {
+        visited.insert(offset);
+        const DBContact *contact = readContact(offset);
+        if (!contact) {
+            break;
+        }
+        const DWORD ofsNext = contact->ofsNext;
+        walkContact(offset, false);
+        offset = ofsNext;
+    }
+}
+
+QVector<ScanRange> ChainWalker::uncoveredRanges() const
+{
+    QVector<ScanRange> covered = m_covered;
+    std::sort(covered.begin(), covered.end(), ScanRangeLessThan);
+
+    QVector<ScanRange> uncovered;
+    qint64 pos = 0;
+    for (int i = 0; i < covered.count(); ++i) {
+        if (covered[i].from > pos) {
+            ScanRange range;
+            range.from = pos;
+            range.to = covered[i].from;
+            uncovered.append(range);
+        }
+        pos = qMax(pos, covered[i].to);
+    }
+
+    const qint64 dataSize = m_lastDataAddr - m_firstDataAddr;
+    if (pos < dataSize) {
+        ScanRange range;
+        range.from = pos;
+        range.to = dataSize;
+        uncovered.append(range);
+    }
+
+    return uncovered;
+}
+
+void ChainWalker::takeRecords(CarvedRecords *records) const
+{
+    TakeRecords(m_contacts, &records->contacts);
+    TakeRecords(m_events, &records->events);
+    TakeRecords(m_moduleNames, &records->moduleNames);
+    TakeRecords(m_contactSettings, &records->contactSettings);
+    records->counters.add(m_counters);
+}
+
+bool ChainWalker::isRecordAt(DWORD offset, DWORD signature) const
+{
+    const qint64 dataSize = m_lastDataAddr - m_firstDataAddr;
+    if (offset < sizeof(DBHeader) || offset + Q_INT64_C(4) > dataSize) {
+        return false;
+    }
+
+    return ReadSignature(m_firstDataAddr + offset) == signature;
+}
+
+void ChainWalker::cover(DWORD from, DWORD to)
+{
+    ScanRange range;
+    range.from = from;
+    range.to = to;
+    m_covered.append(range);
+}
+
+bool ChainWalker::isSkipped(DWORD offset) const
+{
+    // the offset isn't validated yet, it may be outside of the image
+    const DWORD bit = offset / SKIPPED_GRANULE_SIZE;
+    return bit < static_cast<DWORD>(m_skipped.size()) && m_skipped.testBit(bit);
+}
+
+// The rejected records are marked in the bitmap with one bit per 16
+// bytes, the bitmap is allocated once by the first rejected record. The
+// settings and the events are at least 16 bytes, so the records which
+// don't overlap never share the bit
+void ChainWalker::skip(DWORD offset)
+{
+    if (m_skipped.isEmpty()) {
+        const qint64 dataSize = m_lastDataAddr - m_firstDataAddr;
+        m_skipped.resize(static_cast<int>(dataSize / SKIPPED_GRANULE_SIZE) + 1);
+    }
+    m_skipped.setBit(offset / SKIPPED_GRANULE_SIZE);
+}
+
+void ChainWalker::walkModuleNames(DWORD offset)
+{
+    while (offset && !m_moduleNames.contains(offset)) {
+        const DBModuleName *moduleName = readModuleName(offset);
+        if (!moduleName) {
+            break;
+        }
+        offset = moduleName->ofsNext;
+    }
+}
+
+// the settings of the user contact are the accounts, they are kept
+// even if the user contact isn't selected
+void ChainWalker::walkContact(DWORD offset, bool user)
+{
+    const DBContact *contact = readContact(offset);
+    if (!contact) {
+        return;
+    }
+
+    const DWORD ofsFirstSettings = contact->ofsFirstSettings;
+    const DWORD ofsFirstEvent = contact->ofsFirstEvent;
+    const DWORD ofsLastEvent = contact->ofsLastEvent;
+
+    const bool selected = AcceptContact(m_filter, offset);
+    walkSettings(ofsFirstSettings, selected || user);
+    // the broken chain of the events is read from the both ends
+    walkEvents(ofsFirstEvent, true, selected);
+    walkEvents(ofsLastEvent, false, selected);
+}
+
+void ChainWalker::walkSettings(DWORD offset, bool keep)
+{
+    while (offset && !m_contactSettings.contains(offset) && !isSkipped(offset)) {
+        DBContactSettings settings;
+        if (!readSettings(offset, &settings)) {
+            break;
+        }
+        if (keep) {
+            m_contactSettings.insert(offset, settings);
+        }
+        else {
+            skip(offset);
+            ++m_counters.filtered[ContactSettingsRecord];
+        }
+        offset = settings.ofsNext;
+    }
+}
+
+void ChainWalker::walkEvents(DWORD offset, bool forward, bool keep)
+{
+    while (offset && !m_events.contains(offset) && !isSkipped(offset)) {
+        DBEvent event;
+        if (!readEvent(offset, &event)) {
+            break;
+        }
+        if (keep && AcceptEvent(m_filter, m_firstDataAddr, m_lastDataAddr, event)) {
+            m_events.insert(offset, event);
+        }
+        else {
+            skip(offset);
+            ++m_counters.filtered[EventRecord];
+        }
+        offset = forward ? event.ofsNext : event.ofsPrev;
+    }
+}
+
+const DBModuleName *ChainWalker::readModuleName(DWORD offset)
+{
+    QHash<DWORD, DBModuleName>::const_iterator it = m_moduleNames.constFind(offset);
+    if (it != m_moduleNames.constEnd()) {
+        return &it.value();
+    }
+
+    if (!isRecordAt(offset, DBMODULENAME_SIGNATURE)) {
+        return 0;
+    }
+
+    try {
+        const DBModuleName moduleName = ReadDBModuleName(m_firstDataAddr,
+                                                         m_firstDataAddr + offset,
+                                                         m_lastDataAddr);
+        cover(offset, moduleName.name.offset + moduleName.name.size);
+        return &m_moduleNames.insert(offset, moduleName).value();
+    }
+    catch (...) {
+        return 0;
+    }
+}
+
+const DBContact *ChainWalker::readContact(DWORD offset)
+{
+    QHash<DWORD, DBContact>::const_iterator it = m_contacts.constFind(offset);
+    if (it != m_contacts.constEnd()) {
+        return &it.value();
+    }
+
+    if (!isRecordAt(offset, DBCONTACT_SIGNATURE)) {
+        return 0;
+    }
+
+    try {
+        const DBContact contact = ReadDBContact(m_firstDataAddr + offset, m_lastDataAddr);
+        cover(offset, offset + 32);
+        return &m_contacts.insert(offset, contact).value();
+    }
+    catch (...) {
+        return 0;
+    }
+}
+
+bool ChainWalker::readSettings(DWORD offset, DBContactSettings *settings)
+{
+    if (!isRecordAt(offset, DBCONTACTSETTINGS_SIGNATURE)) {
+        return false;
+    }
+
+    try {
+        *settings = ReadDBContactSettings(m_firstDataAddr, m_firstDataAddr + offset,
+                                          m_lastDataAddr);
+        cover(offset, settings->blob.offset + settings->blob.size);
+        readModuleName(settings->ofsModuleName);
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+bool ChainWalker::readEvent(DWORD offset, DBEvent *event)
+{
+    if (!isRecordAt(offset, DBEVENT_SIGNATURE)) {
+        return false;
+    }
+
+    try {
+        *event = ReadDBEvent(m_firstDataAddr, m_firstDataAddr + offset, m_lastDataAddr);
+        cover(offset, event->blob.offset + event->blob.size);
+        readModuleName(event->ofsModuleName);
+        return true;
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+
+qint64 WalkRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                   const DBHeader &header, int threadCount,
+                   const CarveOptions &options, DBRecords *records)
+{
+    ChainWalker walker(firstDataAddr, lastDataAddr, options.filter);
+    walker.walk(header);
+
+    CarvedRecords walked;
+    walker.takeRecords(&walked);
+    ProgressAddRecords(walked.contacts.count() + walked.events.count()
+                       + walked.moduleNames.count() + walked.contactSettings.count());
+
+    const QVector<ScanRange> ranges = walker.uncoveredRanges();
+    CarvedRecords carved;
+    CarveRecords(firstDataAddr, lastDataAddr, ranges, threadCount, options, &carved);
+
+    MergeRecords(carved, &walked);
+    StoreRecords(firstDataAddr, &walked, records);
+
+    qint64 carvedBytes = 0;
+    for (int i = 0; i < ranges.count(); ++i) {
+        carvedBytes += ranges[i].to - ranges[i].from;
+    }
+
+    return carvedBytes;
+}
+
+
+QVector<DWORD> EventOwners(const DBRecords &records)
+{
+    const EventTable &events = records.events;
+    QVector<DWORD> owners(events.count(), 0);
+    for (int i = 0; i < records.contacts.count(); ++i) {
+        int event = events.indexOf(records.contacts.at(i).ofsFirstEvent);
+        while (event != -1 && owners.at(event) == 0) {
+            owners[event] = records.contacts.offset(i);
+            event = events.indexOf(events.ofsNext(event));
+        }
+    }
+
+    return owners;
+}
@@ -0,0 +1,43 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef CHAINWALKER_H
+#define CHAINWALKER_H
+
+
+#include "recordcarver.h"
+
+
+// Reads the records by the links starting from the header: the chain of
+// the module names, the chain of the contacts and the user contact, the
+// settings and the events of each contact. Each record is validated by
+// the signature and the bounds. The byte ranges which are not covered by
+// the found records (the damaged or free space) are carved by the
+// brutforce algorithm, see CarveRecords(). The chains of the contacts
+// which aren't selected by the filter and the rejected events are only
+// followed to cover their bytes, they aren't stored. Returns the number
+// of the carved bytes
+qint64 WalkRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                   const DBHeader &header, int threadCount,
+                   const CarveOptions &options, DBRecords *records);
+
+
+// The contact of each event which is in the event chain of the found
+// contact, the chain is followed by the links from ofsFirstEvent. The
+// event of several chains belongs to the contact with the least offset.
+// The owners are indexed as records.events, 0 - the event has no owner
+QVector<DWORD> EventOwners(const DBRecords &records);
+
+
+#endif // CHAINWALKER_H
@@ -0,0 +1,343 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "compressedfile.h"
+#include <QRunnable>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+// the size of the block which is passed to the compressor and the
+// number of the blocks which may wait for it
+static const int BLOCK_SIZE = 1024 * 1024;
+static const int MAX_QUEUED_BLOCKS = 4;
+static const int OUTPUT_BUFFER_SIZE = 256 * 1024;
+
+
+bool IsCompressionSupported(OutputCompression compression)
+{
+    switch (compression) {
+    case NoCompression:
+    case GzipCompression:
+        return true;
+    case ZstdCompression:
+#ifdef HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    return false;
+}
+
+
+class OutputEncoder
+{
+public:
+    virtual ~OutputEncoder() {}
+
+    // compresses the data and writes the output to the file, the last
+    // call has the finish flag and writes the end of the stream
+    virtual bool write(QFile *file, const char *data, int size, bool finish) = 0;
+};
+
+
+class StoreEncoder : public OutputEncoder
+{
+public:
+    bool write(QFile *file, const char *data, int size, bool)
+    {
+        return file->write(data, size) == size;
+    }
+};
+
+
+class GzipEncoder : public OutputEncoder
+{
+public:
+    GzipEncoder()
+        : m_output(OUTPUT_BUFFER_SIZE, 0)
+    {
+        m_stream.zalloc = Z_NULL;
+        m_stream.zfree = Z_NULL;
+        m_stream.opaque = Z_NULL;
+        // 16 + the window bits - the gzip header and trailer
+        m_valid = (deflateInit2(&m_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    }
+
+    ~GzipEncoder()
+    {
+        if (m_valid) {
+            deflateEnd(&m_stream);
+        }
+    }
+
+    bool write(QFile *file, const char *data, int size, bool finish)
+    {
+        if (!m_valid) {
+            return false;
+        }
+
+        m_stream.next_in = (Bytef *)data;
+        m_stream.avail_in = size;
+        int result;
+        do {
+            m_stream.next_out = (Bytef *)m_output.data();
+            m_stream.avail_out = m_output.size();
+            result = deflate(&m_stream, finish ? Z_FINISH : Z_NO_FLUSH);
+            if (result == Z_STREAM_ERROR) {
+                return false;
+            }
+            const int used = m_output.size() - m_stream.avail_out;
+            if (file->write(m_output.constData(), used) != used) {
+                return false;
+            }
+        } while (m_stream.avail_out == 0 || (finish && result != Z_STREAM_END));
+
+        return true;
+    }
+
+private:
+    z_stream m_stream;
+    QByteArray m_output;
+    bool m_valid;
+};
+
+
+#ifdef HAVE_ZSTD
+class ZstdEncoder : public OutputEncoder
+{
+public:
+    ZstdEncoder()
+        : m_context(ZSTD_createCCtx()), m_output(OUTPUT_BUFFER_SIZE, 0)
+    {
+        if (m_context) {
+            ZSTD_CCtx_setParameter(m_context, ZSTD_c_compressionLevel, ZSTD_CLEVEL_DEFAULT);
+            ZSTD_CCtx_setParameter(m_context, ZSTD_c_checksumFlag, 1);
+        }
+    }
+
+    ~ZstdEncoder()
+    {
+        ZSTD_freeCCtx(m_context);
+    }
+
+    bool write(QFile *file, const char *data, int size, bool finish)
+    {
+        if (!m_context) {
+            return false;
+        }
+
+        ZSTD_inBuffer input = { data, static_cast<size_t>(size), 0 };
+        bool done;
+        do {
+            ZSTD_outBuffer output = { m_output.data(), static_cast<size_t>(m_output.size()), 0 };
+            const size_t remaining = ZSTD_compressStream2(m_context, &output, &input,
+                                                          finish ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(remaining)) {
+                return false;
+            }
+            if (file->write(m_output.constData(), output.pos) != static_cast<qint64>(output.pos)) {
+                return false;
+            }
+            done = finish ? (remaining == 0) : (input.pos == input.size);
+        } while (!done);
+
+        return true;
+    }
+
+private:
+    ZSTD_CCtx *m_context;
+    QByteArray m_output;
+};
+#endif
+
+
+class CompressedFile::Task : public QRunnable
+{
+public:
+    explicit Task(CompressedFile *file) : m_file(file) {}
+
+    void run()
+    {
+        m_file->run();
+    }
+
+private:
+    CompressedFile *m_file;
+};
+
+
+CompressedFile::CompressedFile(const QString &fileName, OutputCompression compression)
+    : m_file(fileName), m_compression(compression), m_finished(false), m_error(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+
+CompressedFile::~CompressedFile()
+{
+    close();
+}
+
+
+QString CompressedFile::fileName() const
+{
+    return m_file.fileName();
+}
+
+
+bool CompressedFile::open(OpenMode mode)
+{
+    if (isOpen() || (mode & ReadOnly) || !IsCompressionSupported(m_compression)) {
+        return false;
+    }
+    if (!m_file.open(mode)) {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+
+    switch (m_compression) {
+    case GzipCompression:
+        m_encoder.reset(new GzipEncoder);
+        break;
+#ifdef HAVE_ZSTD
+    case ZstdCompression:
+        m_encoder.reset(new ZstdEncoder);
+        break;
+#endif
+    default:
+        m_encoder.reset(new StoreEncoder);
+        break;
+    }
+    m_block.reserve(BLOCK_SIZE);
+    m_finished = false;
+    m_error = false;
+    m_pool.start(new Task(this));
+
+    return QIODevice::open(mode);
+}
+
+
+void CompressedFile::close()
+{
+    if (isOpen()) {
+        finish();
+    }
+}
+
+
+bool CompressedFile::isSequential() const
+{
+    return true;
+}
+
+
+bool CompressedFile::finish()
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    submit();
+    m_mutex.lock();
+    m_finished = true;
+    m_blockQueued.wakeAll();
+    m_mutex.unlock();
+    m_pool.waitForDone();
+
+    m_file.close();
+    m_encoder.reset();
+    QIODevice::close();
+
+    return !m_error && m_file.error() == QFile::NoError;
+}
+
+
+qint64 CompressedFile::readData(char *, qint64)
+{
+    return -1;
+}
+
+
+qint64 CompressedFile::writeData(const char *data, qint64 size)
+{
+    for (qint64 written = 0; written < size; ) {
+        const int chunk = qMin<qint64>(size - written, BLOCK_SIZE - m_block.size());
+        m_block.append(data + written, chunk);
+        written += chunk;
+        if (m_block.size() == BLOCK_SIZE) {
+            submit();
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    return m_error ? -1 : size;
+}
+
+
+void CompressedFile::submit()
+{
+    if (m_block.isEmpty()) {
+        return;
+    }
+
+    m_mutex.lock();
+    while (m_queue.count() >= MAX_QUEUED_BLOCKS) {
+        m_blockTaken.wait(&m_mutex);
+    }
+    m_queue.enqueue(m_block);
+    m_blockQueued.wakeAll();
+    m_mutex.unlock();
+
+    m_block.clear();
+    m_block.reserve(BLOCK_SIZE);
+}
+
+
+void CompressedFile::run()
+{
+    // the blocks are taken until the queue is empty and finished, after
+    // an error they are dropped, so the writer never waits forever
+    m_mutex.lock();
+    for (;;) {
+        while (m_queue.isEmpty() && !m_finished) {
+            m_blockQueued.wait(&m_mutex);
+        }
+        if (m_queue.isEmpty()) {
+            break;
+        }
+        const QByteArray block = m_queue.dequeue();
+        m_blockTaken.wakeAll();
+        const bool error = m_error;
+        m_mutex.unlock();
+
+        const bool ok = error || m_encoder->write(&m_file, block.constData(), block.size(), false);
+
+        m_mutex.lock();
+        m_error = !ok || m_error;
+    }
+    const bool error = m_error;
+    m_mutex.unlock();
+
+    if (!error && !m_encoder->write(&m_file, 0, 0, true)) {
+        m_mutex.lock();
+        m_error = true;
+        m_mutex.unlock();
+    }
+}
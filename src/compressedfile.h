@@ -0,0 +1,87 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef COMPRESSEDFILE_H
+#define COMPRESSEDFILE_H
+
+
+#include <QFile>
+#include <QMutex>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+
+enum OutputCompression {
+    NoCompression,
+    GzipCompression,    // zlib, always available
+    ZstdCompression     // if libzstd was found at the build time
+};
+
+bool IsCompressionSupported(OutputCompression compression);
+
+
+class OutputEncoder;
+
+
+// The output file which is compressed on the fly. The written data are
+// collected into the blocks, the blocks are compressed and written to
+// the file by the background thread, so the compression overlaps with
+// the formatting of the records. The writer waits when the compressor
+// falls behind by several blocks. Without the compression the thread
+// only writes the blocks
+class CompressedFile : public QIODevice
+{
+public:
+    CompressedFile(const QString &fileName, OutputCompression compression);
+    ~CompressedFile();
+
+    QString fileName() const;
+
+    bool open(OpenMode mode);
+    void close();
+    bool isSequential() const;
+
+    // writes the rest of the data and the end of the compressed stream,
+    // closes the file. Returns false if something wasn't written
+    bool finish();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 size);
+
+private:
+    Q_DISABLE_COPY(CompressedFile)
+
+    class Task;
+
+    void submit();
+    void run();
+
+    QFile m_file;
+    OutputCompression m_compression;
+    QScopedPointer<OutputEncoder> m_encoder;
+    QByteArray m_block;
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_blockQueued;
+    QWaitCondition m_blockTaken;
+    QQueue<QByteArray> m_queue;
+    bool m_finished;
+    bool m_error;
+};
+
+
+#endif // COMPRESSEDFILE_H
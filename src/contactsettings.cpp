@@ -0,0 +1,226 @@
+// Copyright 2013-2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//                2011, Ruslan Nigmatullin <euroelessar@yandex.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "contactsettings.h"
+#include "extractionschema.h"
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QTextCodec>
+#include <QThreadPool>
+#include <QVarLengthArray>
+
+
+// the contacts are resolved by the batches, so the threads don't
+// fight for the tasks
+static const int RESOLVE_BATCH_SIZE = 256;
+
+
+static QVariant GetVariant(const BYTE *&data, const BYTE *lastAddr,
+                           QTextDecoder *decoder)
+{
+    CheckBounds(data, lastAddr, 1);
+    BYTE type = ReadByte(data);
+    switch (type) {
+    case DBVT_DELETED:
+        return QVariant();
+    case DBVT_BYTE:
+        CheckBounds(data, lastAddr, 1);
+        return ReadByte(data);
+    case DBVT_WORD:
+        CheckBounds(data, lastAddr, 2);
+        return ReadWord(data);
+    case DBVT_DWORD:
+        CheckBounds(data, lastAddr, 4);
+        return ReadDWord(data);
+    case DBVT_ASCIIZ:
+        return decoder->toUnicode(ReadByteArray(data, lastAddr));
+    case DBVT_UTF8:
+        return QString::fromUtf8(ReadByteArray(data, lastAddr));
+    case DBVT_WCHAR: {
+        CheckBounds(data, lastAddr, 2);
+        WORD length = ReadWord(data);
+        CheckBounds(data, lastAddr, length * sizeof(WORD));
+        QVarLengthArray<ushort, 256> array(length);
+        for (int i = 0; i < length; i++)
+            array[i] = ReadWord(data);
+        return QString::fromUtf16(array.constData(), length);
+    }
+    case DBVT_BLOB:
+        return ReadByteArray(data, lastAddr);
+    default:
+        return QVariant();
+    }
+}
+
+
+// the same as GetVariant, but the value isn't decoded
+static void SkipVariant(const BYTE *&data, const BYTE *lastAddr)
+{
+    CheckBounds(data, lastAddr, 1);
+    BYTE type = ReadByte(data);
+    switch (type) {
+    case DBVT_BYTE:
+        CheckBounds(data, lastAddr, 1);
+        data += 1;
+        break;
+    case DBVT_WORD:
+        CheckBounds(data, lastAddr, 2);
+        data += 2;
+        break;
+    case DBVT_DWORD:
+        CheckBounds(data, lastAddr, 4);
+        data += 4;
+        break;
+    case DBVT_ASCIIZ:
+    case DBVT_UTF8:
+    case DBVT_BLOB: {
+        CheckBounds(data, lastAddr, 2);
+        WORD length = ReadWord(data);
+        CheckBounds(data, lastAddr, length);
+        data += length;
+        break;
+    }
+    case DBVT_WCHAR: {
+        CheckBounds(data, lastAddr, 2);
+        WORD length = ReadWord(data);
+        CheckBounds(data, lastAddr, length * sizeof(WORD));
+        data += length * sizeof(WORD);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+
+ContactSettings GetSettings(const BYTE *firstDataAddr,
+                            const DBContact &contact,
+                            const DBRecords &records,
+                            QTextDecoder *decoder,
+                            const SettingsFilter *filter)
+{
+    ContactSettings topResult;
+    DWORD offset = contact.ofsFirstSettings;
+    // the broken chain may be looped
+    int limit = records.contactSettings.count();
+    while (offset && limit-- > 0) {
+        const int settingsIndex = records.contactSettings.indexOf(offset);
+        if (settingsIndex == -1) {
+            break;
+        }
+        const DBContactSettings &contact_settings = records.contactSettings.at(settingsIndex);
+        if (contact_settings.moduleId != UNKNOWN_MODULE_ID
+                && (!filter || filter->isModuleWanted(contact_settings.moduleId))) {
+            ModuleSettings result;
+            const BYTE *data = ViewData(firstDataAddr, contact_settings.blob);
+            const BYTE *lastAddr = data + contact_settings.blob.size;
+            try {
+                while (true) {
+                    CheckBounds(data, lastAddr, 1);
+                    BYTE length = ReadByte(data);
+                    CheckBounds(data, lastAddr, length);
+                    if (length == 0) {
+                        break;
+                    }
+                    if (filter && !filter->isKeyWanted(contact_settings.moduleId,
+                                                       (const char *)data, length)) {
+                        data += length;
+                        SkipVariant(data, lastAddr);
+                        continue;
+                    }
+                    QByteArray key = QByteArray((const char *)data, length);
+                    data += length;
+                    QVariant value = GetVariant(data, lastAddr, decoder);
+                    if (!value.isNull()) {
+                        result.insert(QString::fromLatin1(key, key.size()).toLower(), value);
+                    }
+                }
+            }
+            catch (...) {
+            }
+
+            topResult.insert(records.moduleNameTable.name(contact_settings.moduleId), result);
+        }
+        offset = contact_settings.ofsNext;
+    }
+
+    return topResult;
+}
+
+
+class ResolveSettingsTask : public QRunnable
+{
+public:
+    ResolveSettingsTask(const BYTE *firstDataAddr, const DBRecords *records,
+                        const QVector<DWORD> *contactIds,
+                        const SettingsFilter *filter, int from, int to,
+                        ContactSettings *settings)
+        : m_firstDataAddr(firstDataAddr), m_records(records),
+          m_contactIds(contactIds), m_filter(filter), m_from(from), m_to(to),
+          m_settings(settings)
+    {
+    }
+
+    void run()
+    {
+        // the decoder keeps the state, so each task has its own
+        QScopedPointer<QTextDecoder> decoder(
+                    QTextCodec::codecForName("CP1251")->makeDecoder());
+        for (int i = m_from; i < m_to; ++i) {
+            const DWORD id = m_contactIds->at(i);
+            m_settings[i] = GetSettings(m_firstDataAddr,
+                                        m_records->contacts.value(id),
+                                        *m_records, decoder.data(), m_filter);
+        }
+    }
+
+private:
+    const BYTE *m_firstDataAddr;
+    const DBRecords *m_records;
+    const QVector<DWORD> *m_contactIds;
+    const SettingsFilter *m_filter;
+    int m_from;
+    int m_to;
+    ContactSettings *m_settings;
+};
+
+
+QVector<ContactSettings> ResolveSettings(const BYTE *firstDataAddr,
+                                         const DBRecords &records,
+                                         const QVector<DWORD> &contactIds,
+                                         int threadCount,
+                                         const SettingsFilter *filter)
+{
+    QVector<ContactSettings> settings(contactIds.count());
+    if (threadCount <= 1 || contactIds.count() <= RESOLVE_BATCH_SIZE) {
+        ResolveSettingsTask(firstDataAddr, &records, &contactIds, filter,
+                            0, contactIds.count(), settings.data()).run();
+        return settings;
+    }
+
+    // each task writes only its own items of the result, the vector
+    // is neither resized nor shared, so the tasks don't need the
+    // synchronization
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+    for (int from = 0; from < contactIds.count(); from += RESOLVE_BATCH_SIZE) {
+        const int to = qMin(from + RESOLVE_BATCH_SIZE, contactIds.count());
+        pool.start(new ResolveSettingsTask(firstDataAddr, &records, &contactIds,
+                                           filter, from, to, settings.data()));
+    }
+    pool.waitForDone();
+
+    return settings;
+}
@@ -0,0 +1,56 @@
+// Copyright 2013-2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//                2011, Ruslan Nigmatullin <euroelessar@yandex.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef CONTACTSETTINGS_H
+#define CONTACTSETTINGS_H
+
+
+#include "recordcarver.h"
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+class QTextDecoder;
+class SettingsFilter;
+
+
+// the settings of the one module: lower-cased key -> value
+typedef QMap<QString, QVariant> ModuleSettings;
+// the settings of the contact: module name -> settings of the module
+typedef QMap<QString, ModuleSettings> ContactSettings;
+
+
+// Decodes the chain of the DBContactSettings of the contact. The records
+// are only read, so the function may be called from several threads if
+// each thread has its own decoder. If the filter is set only its modules
+// and keys are decoded, the other values are skipped
+ContactSettings GetSettings(const BYTE *firstDataAddr,
+                            const DBContact &contact,
+                            const DBRecords &records,
+                            QTextDecoder *decoder,
+                            const SettingsFilter *filter = 0);
+
+// Decodes the settings of the contacts, each chain is decoded once. The
+// contacts are distributed between threadCount threads, the result has
+// the same order as contactIds
+QVector<ContactSettings> ResolveSettings(const BYTE *firstDataAddr,
+                                         const DBRecords &records,
+                                         const QVector<DWORD> &contactIds,
+                                         int threadCount,
+                                         const SettingsFilter *filter = 0);
+
+
+#endif // CONTACTSETTINGS_H
@@ -0,0 +1,47 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "eventtext.h"
+#include "textsanitizer.h"
+#include <QTextDecoder>
+#include <QVarLengthArray>
+
+
+// the text of the carved event can have any cbBlob up to the end of the
+// image, only the first megabyte of it is decoded
+static const DWORD MAX_EVENT_TEXT_SIZE = 1024 * 1024;
+
+
+QString DecodeEventText(const BYTE *firstDataAddr, const DBEvent &event,
+                        QTextDecoder *decoder)
+{
+    // the text is copied up to the zero byte and sanitized in one pass,
+    // the ascii text is the same in utf-8 and cp1251, so the codecs
+    // are used only for the other texts
+    const DWORD blobSize = qMin(event.blob.size, MAX_EVENT_TEXT_SIZE);
+    QVarLengthArray<char, 4096> text(blobSize);
+    bool ascii = false;
+    const int size = SanitizeText(ViewData(firstDataAddr, event.blob),
+                                  blobSize, text.data(), &ascii);
+
+    if (ascii) {
+        return QString::fromLatin1(text.constData(), size);
+    }
+    else if (event.flags & DBEF_UTF) {
+        return QString::fromUtf8(text.constData(), size);
+    }
+    else {
+        return decoder->toUnicode(text.constData(), size);
+    }
+}
@@ -0,0 +1,32 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef EVENTTEXT_H
+#define EVENTTEXT_H
+
+
+#include "mirandadb.h"
+#include <QString>
+class QTextDecoder;
+
+
+// Decodes the text of the message event: utf-8 if the event has the
+// DBEF_UTF flag, otherwise by the decoder. The control characters
+// except the tabs and the line breaks are replaced by the spaces. The
+// text longer than 1MB is truncated
+QString DecodeEventText(const BYTE *firstDataAddr, const DBEvent &event,
+                        QTextDecoder *decoder);
+
+
+#endif // EVENTTEXT_H
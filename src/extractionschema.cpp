@@ -0,0 +1,221 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "extractionschema.h"
+#include <json.h>
+#include <QFile>
+
+
+struct SchemaRow {
+    const char *group;
+    const char *module;
+    const char *field;
+    const char *key;
+};
+
+
+static const SchemaRow DEFAULT_ACCOUNTS[] = {
+    { "vk",     "VKontakte",    "useremail",    "useremail" },
+    { "jabber", "JABBER",       "jid",          "jid"       },
+    { "icq",    "ICQ",          "uin",          "uin"       },
+    { "msn",    "MSN",          "msn",          "msn"       },
+    { "aim",    "AIM",          "sn",           "sn"        },
+    { "gg",     "GG",           "uin",          "uin"       },
+    { "irc",    "IRC",          "nick",         "nick"      },
+    { "yahoo",  "YAHOO",        "yahoo_id",     "yahoo_id"  },
+};
+
+
+static const SchemaRow DEFAULT_CONTACTS[] = {
+    { "vk",     "VKontakte",    "useremail",    "useremail" },
+    { "vk",     "VKontakte",    "id",           "id"        },
+    { "vk",     "VKontakte",    "nick",         "nick"      },
+    { "jabber", "JABBER",       "jid",          "jid"       },
+    { "jabber", "JABBER",       "nick",         "nick"      },
+    { "icq",    "ICQ",          "uin",          "uin"       },
+    { "icq",    "ICQ",          "nick",         "nick"      },
+    { "icq",    "ICQ",          "firstname",    "firstname" },
+    { "icq",    "ICQ",          "lastname",     "lastname"  },
+    { "msn",    "MSN",          "msn",          "msn"       },
+    { "aim",    "AIM",          "sn",           "sn"        },
+    { "gg",     "GG",           "uin",          "uin"       },
+    { "irc",    "IRC",          "nick",         "nick"      },
+    { "yahoo",  "YAHOO",        "yahoo_id",     "yahoo_id"  },
+};
+
+
+static QList<SchemaGroup> MakeGroups(const SchemaRow *rows, int count)
+{
+    QList<SchemaGroup> groups;
+    for (int i = 0; i < count; ++i) {
+        if (groups.isEmpty() || groups.last().name != rows[i].group) {
+            SchemaGroup group;
+            group.name = rows[i].group;
+            group.module = rows[i].module;
+            groups.append(group);
+        }
+        groups.last().fields.insert(rows[i].field, rows[i].key);
+    }
+
+    return groups;
+}
+
+
+static bool ParseGroups(const QVariant &value, QList<SchemaGroup> *groups)
+{
+    if (value.isNull()) {
+        return true;
+    }
+    if (value.type() != QVariant::List) {
+        return false;
+    }
+
+    foreach (const QVariant &item, value.toList()) {
+        const QVariantMap map = item.toMap();
+        SchemaGroup group;
+        group.name = map.value("name").toString();
+        group.module = map.value("module").toString();
+        if (group.name.isEmpty() || group.module.isEmpty()
+                || map.value("fields").type() != QVariant::Map) {
+            return false;
+        }
+
+        const QVariantMap fields = map.value("fields").toMap();
+        for (QVariantMap::const_iterator it = fields.constBegin(); it != fields.constEnd(); ++it) {
+            // the keys of the settings are lower-cased by the walker
+            const QString key = it.value().toString().toLower();
+            if (key.isEmpty()) {
+                return false;
+            }
+            group.fields.insert(it.key(), key);
+        }
+        groups->append(group);
+    }
+
+    return true;
+}
+
+
+static QVariantMap GroupsMap(const QList<SchemaGroup> &groups,
+                             const ContactSettings &settings)
+{
+    QVariantMap result;
+    foreach (const SchemaGroup &group, groups) {
+        const ContactSettings::const_iterator moduleIt = settings.constFind(group.module);
+        if (moduleIt == settings.constEnd()) {
+            continue;
+        }
+
+        // the missing settings are written as null
+        QVariantMap v;
+        QMap<QString, QString>::const_iterator it;
+        for (it = group.fields.constBegin(); it != group.fields.constEnd(); ++it) {
+            v[it.key()] = moduleIt.value().value(it.value());
+        }
+        result[group.name] = v;
+    }
+
+    return result;
+}
+
+
+ExtractionSchema::ExtractionSchema()
+    : m_accounts(MakeGroups(DEFAULT_ACCOUNTS, sizeof(DEFAULT_ACCOUNTS) / sizeof(SchemaRow))),
+      m_contacts(MakeGroups(DEFAULT_CONTACTS, sizeof(DEFAULT_CONTACTS) / sizeof(SchemaRow)))
+{
+}
+
+bool ExtractionSchema::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_errorString = file.errorString();
+        return false;
+    }
+
+    bool ok = false;
+    const QVariant root = QtJson::parse(QString::fromUtf8(file.readAll()), ok);
+    QList<SchemaGroup> accounts;
+    QList<SchemaGroup> contacts;
+    if (!ok || root.type() != QVariant::Map
+            || !ParseGroups(root.toMap().value("accounts"), &accounts)
+            || !ParseGroups(root.toMap().value("contacts"), &contacts)) {
+        m_errorString = "invalid schema format";
+        return false;
+    }
+
+    m_accounts = accounts;
+    m_contacts = contacts;
+
+    return true;
+}
+
+QVariantMap ExtractionSchema::accountsMap(DWORD userId,
+                                          const ContactSettings &settings) const
+{
+    QVariantMap result = GroupsMap(m_accounts, settings);
+    result["id"] = userId;
+
+    return result;
+}
+
+QVariantMap ExtractionSchema::contactSettingsMap(const ContactSettings &settings) const
+{
+    return GroupsMap(m_contacts, settings);
+}
+
+
+SettingsFilter::SettingsFilter(const ExtractionSchema &schema,
+                               const ModuleNameTable &moduleNameTable)
+    : m_modules(moduleNameTable.count(), false),
+      m_keys(moduleNameTable.count())
+{
+    QHash<QString, WORD> moduleIds;
+    for (int id = 0; id < moduleNameTable.count(); ++id) {
+        moduleIds.insert(moduleNameTable.name(id), id);
+    }
+
+    QList<SchemaGroup> groups = schema.accounts();
+    groups += schema.contacts();
+    foreach (const SchemaGroup &group, groups) {
+        // the unknown module has the empty name and never has settings
+        const WORD id = moduleIds.value(group.module, UNKNOWN_MODULE_ID);
+        if (id == UNKNOWN_MODULE_ID) {
+            continue;
+        }
+
+        // the module without the fields is written as the empty object
+        m_modules[id] = true;
+        foreach (const QString &key, group.fields) {
+            const QByteArray latin1 = key.toLatin1();
+            if (!m_keys[id].contains(latin1)) {
+                m_keys[id].append(latin1);
+            }
+        }
+    }
+}
+
+bool SettingsFilter::isKeyWanted(WORD moduleId, const char *key, int size) const
+{
+    // the schema keys are lower-cased, the keys of the settings are
+    // compared case-insensitively
+    const QList<QByteArray> &keys = m_keys.at(moduleId);
+    for (int i = 0; i < keys.count(); ++i) {
+        if (keys[i].size() == size && qstrnicmp(keys[i].constData(), key, size) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
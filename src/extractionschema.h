@@ -0,0 +1,107 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef EXTRACTIONSCHEMA_H
+#define EXTRACTIONSCHEMA_H
+
+
+#include "contactsettings.h"
+#include "modulenametable.h"
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+
+// The group of the output fields, e.g. "icq": {"uin": ..., "nick": ...},
+// which are read from the settings of the one module
+struct SchemaGroup {
+    QString name;
+    QString module;
+    QMap<QString, QString> fields;  // output field -> lower-cased setting key
+};
+
+
+// Describes which settings are written to the accounts and the contacts
+// sections of the output. The default schema is built in, the other one
+// may be loaded from the json file:
+//   {"accounts": [{"name": "icq", "module": "ICQ",
+//                  "fields": {"uin": "uin"}}, ...],
+//    "contacts": [...]}
+class ExtractionSchema
+{
+public:
+    ExtractionSchema();
+
+    bool load(const QString &fileName);
+
+    inline const QList<SchemaGroup> &accounts() const;
+    inline const QList<SchemaGroup> &contacts() const;
+
+    // the output of the accounts section for the user contact and
+    // the output of the settings of the other contacts
+    QVariantMap accountsMap(DWORD userId, const ContactSettings &settings) const;
+    QVariantMap contactSettingsMap(const ContactSettings &settings) const;
+
+    inline const QString &errorString() const;
+
+private:
+    QList<SchemaGroup> m_accounts;
+    QList<SchemaGroup> m_contacts;
+    QString m_errorString;
+};
+
+const QList<SchemaGroup> &ExtractionSchema::accounts() const
+{
+    return m_accounts;
+}
+
+const QList<SchemaGroup> &ExtractionSchema::contacts() const
+{
+    return m_contacts;
+}
+
+const QString &ExtractionSchema::errorString() const
+{
+    return m_errorString;
+}
+
+
+// The schema compiled for the module ids of the database: the settings
+// walker skips the modules and the keys which aren't in the schema
+// without decoding their values
+class SettingsFilter
+{
+public:
+    SettingsFilter(const ExtractionSchema &schema,
+                   const ModuleNameTable &moduleNameTable);
+
+    inline bool isModuleWanted(WORD moduleId) const;
+    bool isKeyWanted(WORD moduleId, const char *key, int size) const;
+
+private:
+    // by the module id
+    QVector<bool> m_modules;
+    QVector<QList<QByteArray> > m_keys;
+};
+
+bool SettingsFilter::isModuleWanted(WORD moduleId) const
+{
+    return m_modules.at(moduleId);
+}
+
+
+#endif // EXTRACTIONSCHEMA_H
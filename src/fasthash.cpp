@@ -0,0 +1,122 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "fasthash.h"
+#include <QtEndian>
+#include <cstring>
+
+
+static const quint64 PRIME64_1 = Q_UINT64_C(11400714785074694791);
+static const quint64 PRIME64_2 = Q_UINT64_C(14029467366897019727);
+static const quint64 PRIME64_3 = Q_UINT64_C(1609587929392839161);
+static const quint64 PRIME64_4 = Q_UINT64_C(9650029242287828579);
+static const quint64 PRIME64_5 = Q_UINT64_C(2870177450012600261);
+
+
+static inline quint64 RotateLeft(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+static inline quint64 Read64(const uchar *data)
+{
+    quint64 value;
+    memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+
+static inline quint32 Read32(const uchar *data)
+{
+    quint32 value;
+    memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+
+static inline quint64 Round(quint64 acc, quint64 input)
+{
+    acc += input * PRIME64_2;
+    acc = RotateLeft(acc, 31);
+    return acc * PRIME64_1;
+}
+
+
+static inline quint64 MergeRound(quint64 acc, quint64 value)
+{
+    acc ^= Round(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+
+quint64 FastHash64(const void *data, qint64 size, quint64 seed)
+{
+    const uchar *p = (const uchar *)data;
+    const uchar *const end = p + size;
+
+    quint64 hash;
+    if (size >= 32) {
+        quint64 v1 = seed + PRIME64_1 + PRIME64_2;
+        quint64 v2 = seed + PRIME64_2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - PRIME64_1;
+        const uchar *const limit = end - 32;
+        do {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7)
+             + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    }
+    else {
+        hash = seed + PRIME64_5;
+    }
+
+    hash += static_cast<quint64>(size);
+
+    while (end - p >= 8) {
+        hash ^= Round(0, Read64(p));
+        hash = RotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+
+    if (end - p >= 4) {
+        hash ^= static_cast<quint64>(Read32(p)) * PRIME64_1;
+        hash = RotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end) {
+        hash ^= (*p) * PRIME64_5;
+        hash = RotateLeft(hash, 11) * PRIME64_1;
+        ++p;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= PRIME64_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
@@ -0,0 +1,26 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef FASTHASH_H
+#define FASTHASH_H
+
+
+#include <QtGlobal>
+
+
+// The fast non-cryptographic 64-bit hash (XXH64)
+quint64 FastHash64(const void *data, qint64 size, quint64 seed = 0);
+
+
+#endif // FASTHASH_H
@@ -0,0 +1,187 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "imagerecovery.h"
+#include "eventtext.h"
+#include "imagesource.h"
+#include "jsonwriter.h"
+#include "progress.h"
+#include "recordcarver.h"
+#include <QScopedPointer>
+#include <QTextCodec>
+#include <cstring>
+#include <iostream>
+
+
+static const qint64 IMAGE_WINDOW_SIZE = 64 * 1024 * 1024;
+// the record which begins at the end of the window is read from the
+// overlap, the larger records are lost on the window boundary
+static const qint64 IMAGE_OVERLAP_SIZE = 1024 * 1024;
+
+
+static void BeginLine(JsonWriter *writer, const char *section, qint64 offset)
+{
+    writer->beginObject();
+    writer->writeKey(section);
+    writer->beginObject();
+    writer->writeKey("offset");
+    writer->writeNumber(offset);
+}
+
+
+static void EndLine(JsonWriter *writer)
+{
+    writer->endObject();
+    writer->endObject();
+    writer->endLine();
+}
+
+
+bool image2json(const QString &imageFileName,
+                const QString &outputFileName,
+                const Miranda2JsonOptions &options)
+{
+    QScopedPointer<QTextDecoder> decoder(QTextCodec::codecForName("CP1251")->makeDecoder());
+
+    ImageSource source(IMAGE_WINDOW_SIZE, IMAGE_OVERLAP_SIZE);
+    if (!source.open(imageFileName)) {
+        std::cerr << "can't open file for read: " << imageFileName.toStdString()
+                  << " (" << source.errorString().toStdString() << ")" << std::endl;
+        return false;
+    }
+
+    CompressedFile outputFile(outputFileName, options.compression);
+    if (!outputFile.open(QIODevice::WriteOnly)) {
+        std::cerr << "can't open file for write: " << outputFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    // the window isn't the database, the links of the records are the
+    // offsets inside the unknown database, so they aren't validated
+    CarveOptions carveOptions;
+    carveOptions.rescanInterior = options.rescanInterior;
+    carveOptions.checkLinks = false;
+    carveOptions.includeWeak = options.includeWeak;
+    carveOptions.filter = &options.filter;
+
+    JsonWriter writer(&outputFile);
+    qint64 imageSize = 0;
+    qint64 databaseCount = 0;
+    qint64 contactCount = 0;
+    qint64 eventCount = 0;
+    qint64 moduleNameCount = 0;
+    const int signatureSize = strlen(DBHEADER_SIGNATURE);
+    while (!IsStopRequested() && source.nextWindow()) {
+        const BYTE *firstDataAddr = source.data();
+        const BYTE *lastDataAddr = firstDataAddr + source.size();
+        const qint64 windowOffset = source.offset();
+        imageSize = windowOffset + source.windowSize();
+
+        // the headers of the databases show where the profiles were
+        const QByteArray window = QByteArray::fromRawData(
+                    (const char *)firstDataAddr,
+                    qMin(source.size(), source.windowSize() + signatureSize - 1));
+        for (int pos = window.indexOf(DBHEADER_SIGNATURE); pos != -1;
+             pos = window.indexOf(DBHEADER_SIGNATURE, pos + 1)) {
+            BeginLine(&writer, "databases", windowOffset + pos);
+            EndLine(&writer);
+            ++databaseCount;
+        }
+
+        ScanRange range;
+        range.from = 0;
+        range.to = source.windowSize();
+        CarvedRecords carved;
+        CarveRecords(firstDataAddr, lastDataAddr, QVector<ScanRange>() << range,
+                     options.threadCount, carveOptions, &carved);
+
+        for (int i = 0; i < carved.moduleNames.count(); ++i) {
+            const DBModuleName &moduleName = carved.moduleNames.at(i);
+            BeginLine(&writer, "module_names", windowOffset + carved.moduleNames.offset(i));
+            writer.writeKey("name");
+            writer.writeString(QString::fromUtf8((const char *)ViewData(firstDataAddr, moduleName.name),
+                                                 ViewStringSize(firstDataAddr, moduleName.name)));
+            writer.writeKey("next_id");
+            writer.writeNumber(moduleName.ofsNext);
+            EndLine(&writer);
+        }
+        moduleNameCount += carved.moduleNames.count();
+
+        for (int i = 0; i < carved.contacts.count(); ++i) {
+            const DBContact &contact = carved.contacts.at(i);
+            BeginLine(&writer, "contacts", windowOffset + carved.contacts.offset(i));
+            writer.writeKey("event_count");
+            writer.writeNumber(contact.eventCount);
+            writer.writeKey("first_event_id");
+            writer.writeNumber(contact.ofsFirstEvent);
+            writer.writeKey("first_unread_event_id");
+            writer.writeNumber(contact.ofsFirstUnreadEvent);
+            writer.writeKey("last_event_id");
+            writer.writeNumber(contact.ofsLastEvent);
+            writer.writeKey("next_id");
+            writer.writeNumber(contact.ofsNext);
+            EndLine(&writer);
+        }
+        contactCount += carved.contacts.count();
+
+        for (int i = 0; i < carved.events.count(); ++i) {
+            const DBEvent event = carved.events.at(i);
+            if (!IsMessageEvent(event.eventType)) {
+                continue;
+            }
+            BeginLine(&writer, "events", windowOffset + carved.events.offset(i));
+            writer.writeKey("incomming");
+            writer.writeBool(!(event.flags & DBEF_SENT));
+            writer.writeKey("module_name_id");
+            writer.writeNumber(event.ofsModuleName);
+            writer.writeKey("next_id");
+            writer.writeNumber(event.ofsNext);
+            writer.writeKey("prev_id");
+            writer.writeNumber(event.ofsPrev);
+            writer.writeKey("text");
+            writer.writeString(DecodeEventText(firstDataAddr, event, decoder.data()));
+            writer.writeKey("timestamp");
+            writer.writeNumber(event.timestamp);
+            EndLine(&writer);
+            ++eventCount;
+        }
+    }
+
+    if (source.hasError()) {
+        std::cerr << "can't read file: " << imageFileName.toStdString()
+                  << " (" << source.errorString().toStdString() << ")" << std::endl;
+        return false;
+    }
+
+    if (!writer.flush() || !outputFile.finish()) {
+        std::cerr << "can't write file: " << outputFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    if (options.verbose) {
+        std::cout << "== Found ==" << std::endl;
+        std::cout << "  Image bytes      : " << imageSize << std::endl;
+        std::cout << "  Databases        : " << databaseCount << std::endl;
+        std::cout << "  DBContact        : " << contactCount << std::endl;
+        std::cout << "  DBEvent          : " << eventCount << std::endl;
+        std::cout << "  DBModuleName     : " << moduleNameCount << std::endl;
+    }
+
+    if (IsStopRequested()) {
+        std::cerr << "interrupted, the output is partial: " << outputFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    return true;
+}
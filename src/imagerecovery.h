@@ -0,0 +1,33 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef IMAGERECOVERY_H
+#define IMAGERECOVERY_H
+
+
+#include "miranda.h"
+
+
+// Carves the records out of the raw disk image or the block device of
+// any size, e.g. the dump of the partition with the deleted profile.
+// The image is read by the windows, see ImageSource. The offsets of the
+// databases are unknown, so the records aren't linked: each found
+// record is written as the ndjson line with its 64-bit image offset,
+// the links are written as they are stored in the record
+bool image2json(const QString &imageFileName,
+                const QString &outputFileName,
+                const Miranda2JsonOptions &options);
+
+
+#endif // IMAGERECOVERY_H
@@ -0,0 +1,173 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "imagesource.h"
+#include <QRunnable>
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+
+class ReadWindowTask : public QRunnable
+{
+public:
+    ReadWindowTask(QFile *file, qint64 offset, QByteArray *buffer,
+                   qint64 *size)
+        : m_file(file), m_offset(offset), m_buffer(buffer), m_size(size)
+    {
+    }
+
+    void run()
+    {
+        // the device may be shorter than expected, so it is read up
+        // to the end of the buffer or the end of the device
+        char *data = m_buffer->data();
+        const qint64 capacity = m_buffer->size();
+        qint64 size = 0;
+#ifdef Q_OS_UNIX
+        const int fd = m_file->handle();
+        while (size < capacity) {
+            const ssize_t count = pread(fd, data + size, capacity - size, m_offset + size);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                size = -1;
+                break;
+            }
+            if (count == 0) {
+                break;
+            }
+            size += count;
+        }
+#else
+        if (m_file->seek(m_offset)) {
+            while (size < capacity) {
+                const qint64 count = m_file->read(data + size, capacity - size);
+                if (count < 0) {
+                    size = -1;
+                    break;
+                }
+                if (count == 0) {
+                    break;
+                }
+                size += count;
+            }
+        }
+        else if (m_offset < m_file->size()) {
+            size = -1;
+        }
+#endif
+        *m_size = size;
+    }
+
+private:
+    QFile *m_file;
+    qint64 m_offset;
+    QByteArray *m_buffer;
+    qint64 *m_size;
+};
+
+
+ImageSource::ImageSource(qint64 windowSize, qint64 overlapSize)
+    : m_windowSize(windowSize), m_overlapSize(overlapSize), m_current(0),
+      m_started(false), m_offset(0), m_size(0), m_nextOffset(0),
+      m_nextSize(0), m_error(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+ImageSource::~ImageSource()
+{
+    close();
+}
+
+bool ImageSource::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_buffers[0].resize(m_windowSize + m_overlapSize);
+    m_buffers[1].resize(m_windowSize + m_overlapSize);
+    startRead(0);
+
+    return true;
+}
+
+void ImageSource::close()
+{
+    m_pool.waitForDone();
+    m_file.close();
+    m_buffers[0].clear();
+    m_buffers[1].clear();
+    m_current = 0;
+    m_started = false;
+    m_offset = 0;
+    m_size = 0;
+    m_error = false;
+}
+
+bool ImageSource::nextWindow()
+{
+    if (!m_file.isOpen() || m_error) {
+        return false;
+    }
+
+    // the last window holds the rest of the image
+    if (m_started && m_size <= m_windowSize) {
+        return false;
+    }
+
+    if (!finishRead()) {
+        return false;
+    }
+
+    // the next window is read while the current one is scanned
+    if (m_size > m_windowSize) {
+        startRead(m_offset + m_windowSize);
+    }
+
+    return m_size > 0;
+}
+
+void ImageSource::startRead(qint64 offset)
+{
+    m_nextOffset = offset;
+    m_nextSize = 0;
+    m_pool.start(new ReadWindowTask(&m_file, offset, &m_buffers[m_current ^ 1],
+                                    &m_nextSize));
+}
+
+bool ImageSource::finishRead()
+{
+    m_pool.waitForDone();
+    if (m_nextSize < 0) {
+        m_error = true;
+        m_errorString = QString("can't read the image at %1").arg(m_nextOffset);
+        return false;
+    }
+
+    m_current ^= 1;
+    m_started = true;
+    m_offset = m_nextOffset;
+    m_size = m_nextSize;
+
+    return true;
+}
@@ -0,0 +1,106 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef IMAGESOURCE_H
+#define IMAGESOURCE_H
+
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QThreadPool>
+
+
+// Reads the raw disk image or the block device by the windows of the
+// fixed size. Each buffer holds the window and the overlap after it, so
+// the record which begins inside the window may be read entirely. There
+// are two buffers: the next window is read in the background while the
+// current one is scanned, the memory doesn't depend on the image size
+class ImageSource
+{
+public:
+    ImageSource(qint64 windowSize, qint64 overlapSize);
+    ~ImageSource();
+
+    bool open(const QString &fileName);
+    void close();
+
+    // moves to the next window, returns false at the end of the image
+    // or if the read is failed, see hasError()
+    bool nextWindow();
+
+    // the offset of the window inside the image
+    inline qint64 offset() const;
+    // the window and the overlap
+    inline const uchar *data() const;
+    inline qint64 size() const;
+    // the records which begin in [0, windowSize()) belong to the window
+    inline qint64 windowSize() const;
+
+    inline bool hasError() const;
+    inline const QString &errorString() const;
+
+private:
+    Q_DISABLE_COPY(ImageSource)
+
+    void startRead(qint64 offset);
+    bool finishRead();
+
+    qint64 m_windowSize;
+    qint64 m_overlapSize;
+    QFile m_file;
+    QThreadPool m_pool;
+    QByteArray m_buffers[2];
+    int m_current;
+    bool m_started;
+    qint64 m_offset;
+    qint64 m_size;
+    qint64 m_nextOffset;
+    qint64 m_nextSize;       // -1 if the read is failed
+    bool m_error;
+    QString m_errorString;
+};
+
+qint64 ImageSource::offset() const
+{
+    return m_offset;
+}
+
+const uchar *ImageSource::data() const
+{
+    return (const uchar *)m_buffers[m_current].constData();
+}
+
+qint64 ImageSource::size() const
+{
+    return m_size;
+}
+
+qint64 ImageSource::windowSize() const
+{
+    return qMin(m_windowSize, m_size);
+}
+
+bool ImageSource::hasError() const
+{
+    return m_error;
+}
+
+const QString &ImageSource::errorString() const
+{
+    return m_errorString;
+}
+
+
+#endif // IMAGESOURCE_H
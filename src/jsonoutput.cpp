@@ -0,0 +1,241 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "jsonoutput.h"
+#include "extractionschema.h"
+#include <iostream>
+
+
+static const char *const SECTION_NAMES[] = {
+    0, "accounts", "contacts", "events", 0
+};
+
+
+JsonOutput::JsonOutput(QIODevice *device, bool ndjson)
+    : m_writer(device), m_ndjson(ndjson), m_section(NoSection),
+      m_accountsWritten(false)
+{
+}
+
+
+void JsonOutput::writeAccounts(const QVariantMap &accounts)
+{
+    beginItem(AccountsSection);
+    m_writer.writeValue(accounts);
+    m_accountsWritten = true;
+    endItem();
+}
+
+
+void JsonOutput::writeContact(DWORD id, DWORD eventCount, DWORD firstEventId,
+                              DWORD firstUnreadEventId, DWORD lastEventId,
+                              const QVariantMap &settings)
+{
+    beginItem(ContactsSection);
+    m_writer.beginObject();
+    m_writer.writeKey("event_count");
+    m_writer.writeNumber(eventCount);
+    m_writer.writeKey("first_event_id");
+    m_writer.writeNumber(firstEventId);
+    m_writer.writeKey("first_unread_event_id");
+    m_writer.writeNumber(firstUnreadEventId);
+    m_writer.writeKey("id");
+    m_writer.writeNumber(id);
+    m_writer.writeKey("last_event_id");
+    m_writer.writeNumber(lastEventId);
+    m_writer.writeKey("settings");
+    m_writer.writeValue(settings);
+    m_writer.endObject();
+    endItem();
+}
+
+
+void JsonOutput::writeEvent(DWORD id, DWORD flags, const QString &moduleName,
+                            DWORD nextId, DWORD prevId, const QString &text,
+                            DWORD timestamp)
+{
+    beginItem(EventsSection);
+    m_writer.beginObject();
+    m_writer.writeKey("id");
+    m_writer.writeNumber(id);
+    m_writer.writeKey("incomming");
+    m_writer.writeBool(!(flags & DBEF_SENT));
+    m_writer.writeKey("module_name");
+    m_writer.writeString(moduleName);
+    m_writer.writeKey("next_id");
+    m_writer.writeNumber(nextId);
+    m_writer.writeKey("prev_id");
+    m_writer.writeNumber(prevId);
+    m_writer.writeKey("text");
+    m_writer.writeString(text);
+    m_writer.writeKey("timestamp");
+    m_writer.writeNumber(timestamp);
+    m_writer.endObject();
+    endItem();
+}
+
+
+bool JsonOutput::finish()
+{
+    beginItem(FinishedSection);
+    return m_writer.flush();
+}
+
+
+// json: the items are the elements of the section array, the accounts
+// are the value of the key; ndjson: each item is the separate line
+void JsonOutput::beginItem(Section section)
+{
+    while (m_section < section) {
+        if (!m_ndjson) {
+            switch (m_section) {
+            case NoSection:
+                m_writer.beginObject();
+                break;
+            case AccountsSection:
+                if (!m_accountsWritten) {
+                    m_writer.writeValue(QVariantMap());
+                }
+                break;
+            default:
+                m_writer.endArray();
+                break;
+            }
+        }
+
+        m_section = static_cast<Section>(m_section + 1);
+        if (!m_ndjson) {
+            switch (m_section) {
+            case AccountsSection:
+                m_writer.writeKey(SECTION_NAMES[m_section]);
+                break;
+            case FinishedSection:
+                m_writer.endObject();
+                break;
+            default:
+                m_writer.writeKey(SECTION_NAMES[m_section]);
+                m_writer.beginArray();
+                break;
+            }
+        }
+    }
+
+    if (m_ndjson && section != FinishedSection) {
+        m_writer.beginObject();
+        m_writer.writeKey(SECTION_NAMES[section]);
+    }
+}
+
+
+void JsonOutput::endItem()
+{
+    if (m_ndjson) {
+        m_writer.endObject();
+        m_writer.endLine();
+    }
+}
+
+
+JsonOutputVisitor::JsonOutputVisitor(const QString &fileName, bool ndjson,
+                                     const ExtractionSchema &schema,
+                                     OutputCompression compression)
+    : m_file(fileName, compression), m_ndjson(ndjson), m_schema(schema),
+      m_userContactId(0), m_contactsWritten(false)
+{
+}
+
+
+const ExtractionSchema *JsonOutputVisitor::schema() const
+{
+    return &m_schema;
+}
+
+
+void JsonOutputVisitor::onBegin(const DBHeader &header)
+{
+    m_userContactId = header.ofsUser;
+
+    if (!m_file.open(QIODevice::WriteOnly)) {
+        std::cerr << "can't open file for write: " << m_file.fileName().toStdString() << std::endl;
+        return;
+    }
+    m_output.reset(new JsonOutput(&m_file, m_ndjson));
+}
+
+
+void JsonOutputVisitor::onContact(DWORD id, const DBContact &contact)
+{
+    Contact item;
+    item.id = id;
+    item.contact = contact;
+    m_contacts.append(item);
+}
+
+
+void JsonOutputVisitor::onSettings(DWORD contactId, const ContactSettings &settings)
+{
+    if (contactId == m_userContactId) {
+        m_accounts = m_schema.accountsMap(contactId, settings);
+    }
+    if (!m_contacts.isEmpty() && m_contacts.last().id == contactId) {
+        m_contacts.last().settings = m_schema.contactSettingsMap(settings);
+    }
+}
+
+
+void JsonOutputVisitor::onEvent(const EventView &event)
+{
+    writeContacts();
+    if (m_output && event.isMessage()) {
+        const DBEvent &dbEvent = event.event();
+        m_output->writeEvent(event.id(), dbEvent.flags, event.moduleName(),
+                             dbEvent.ofsNext, dbEvent.ofsPrev, event.text(),
+                             dbEvent.timestamp);
+    }
+}
+
+
+bool JsonOutputVisitor::onEnd()
+{
+    if (!m_output) {
+        return false;
+    }
+
+    writeContacts();
+    if (!m_output->finish() || !m_file.finish()) {
+        std::cerr << "can't write file: " << m_file.fileName().toStdString() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+void JsonOutputVisitor::writeContacts()
+{
+    if (!m_output || m_contactsWritten) {
+        return;
+    }
+
+    m_output->writeAccounts(m_accounts);
+    for (int i = 0; i < m_contacts.count(); ++i) {
+        const Contact &item = m_contacts.at(i);
+        m_output->writeContact(item.id, item.contact.eventCount,
+                               item.contact.ofsFirstEvent,
+                               item.contact.ofsFirstUnreadEvent,
+                               item.contact.ofsLastEvent, item.settings);
+    }
+    m_contacts.clear();
+    m_contactsWritten = true;
+}
@@ -0,0 +1,105 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef JSONOUTPUT_H
+#define JSONOUTPUT_H
+
+
+#include "compressedfile.h"
+#include "jsonwriter.h"
+#include "recoveryvisitor.h"
+#include <QScopedPointer>
+#include <QVariantMap>
+#include <QVector>
+
+
+// Writes the json document {"accounts": {}, "contacts": [], "events": []}
+// or the same items as the ndjson lines {"section": item}. The sections
+// are written in that order: the item of the next section closes the
+// previous one, the missed sections are written empty
+class JsonOutput
+{
+public:
+    JsonOutput(QIODevice *device, bool ndjson);
+
+    void writeAccounts(const QVariantMap &accounts);
+    void writeContact(DWORD id, DWORD eventCount, DWORD firstEventId,
+                      DWORD firstUnreadEventId, DWORD lastEventId,
+                      const QVariantMap &settings);
+    void writeEvent(DWORD id, DWORD flags, const QString &moduleName,
+                    DWORD nextId, DWORD prevId, const QString &text,
+                    DWORD timestamp);
+
+    // closes the document and writes the rest of the buffer
+    bool finish();
+
+private:
+    enum Section {
+        NoSection,
+        AccountsSection,
+        ContactsSection,
+        EventsSection,
+        FinishedSection
+    };
+
+    void beginItem(Section section);
+    void endItem();
+
+    JsonWriter m_writer;
+    bool m_ndjson;
+    Section m_section;
+    bool m_accountsWritten;
+};
+
+
+// Writes the recovered records to the json or ndjson file, only the
+// settings of the schema. The file is created when the records are
+// found. The accounts are the settings of the user contact, so the
+// contacts are kept until the first event
+class JsonOutputVisitor : public RecoveryVisitor
+{
+public:
+    JsonOutputVisitor(const QString &fileName, bool ndjson,
+                      const ExtractionSchema &schema,
+                      OutputCompression compression = NoCompression);
+
+    const ExtractionSchema *schema() const;
+
+    void onBegin(const DBHeader &header);
+    void onContact(DWORD id, const DBContact &contact);
+    void onSettings(DWORD contactId, const ContactSettings &settings);
+    void onEvent(const EventView &event);
+    bool onEnd();
+
+private:
+    struct Contact {
+        DWORD id;
+        DBContact contact;
+        QVariantMap settings;
+    };
+
+    void writeContacts();
+
+    CompressedFile m_file;
+    bool m_ndjson;
+    QScopedPointer<JsonOutput> m_output;
+    const ExtractionSchema &m_schema;
+    DWORD m_userContactId;
+    QVariantMap m_accounts;
+    QVector<Contact> m_contacts;
+    bool m_contactsWritten;
+};
+
+
+#endif // JSONOUTPUT_H
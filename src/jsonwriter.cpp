@@ -0,0 +1,301 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "jsonwriter.h"
+#include <cstring>
+
+
+// the longest representation of the one character inside the string:
+// \u00XX for the control characters or 4 bytes of utf-8
+static const int MAX_ESCAPED_CHAR_SIZE = 6;
+
+
+JsonWriter::JsonWriter(QIODevice *device, int bufferSize)
+    : m_device(device), m_used(0), m_error(false), m_afterKey(false)
+{
+    m_buffer.resize(qMax(bufferSize, 64));
+}
+
+JsonWriter::~JsonWriter()
+{
+    flush();
+}
+
+void JsonWriter::beginObject()
+{
+    beginValue();
+    put('{');
+    m_empty.append(true);
+}
+
+void JsonWriter::endObject()
+{
+    put('}');
+    m_empty.removeLast();
+}
+
+void JsonWriter::beginArray()
+{
+    beginValue();
+    put('[');
+    m_empty.append(true);
+}
+
+void JsonWriter::endArray()
+{
+    put(']');
+    m_empty.removeLast();
+}
+
+void JsonWriter::writeKey(const char *key)
+{
+    beginValue();
+    put('"');
+    put(key, strlen(key));
+    put('"');
+    put(':');
+    m_afterKey = true;
+}
+
+void JsonWriter::writeNull()
+{
+    beginValue();
+    put("null", 4);
+}
+
+void JsonWriter::writeBool(bool value)
+{
+    beginValue();
+    if (value) {
+        put("true", 4);
+    }
+    else {
+        put("false", 5);
+    }
+}
+
+void JsonWriter::writeNumber(qint64 value)
+{
+    beginValue();
+    if (value < 0) {
+        put('-');
+        putNumber(0 - static_cast<quint64>(value));
+    }
+    else {
+        putNumber(static_cast<quint64>(value));
+    }
+}
+
+void JsonWriter::writeNumber(quint64 value)
+{
+    beginValue();
+    putNumber(value);
+}
+
+void JsonWriter::writeNumber(double value)
+{
+    beginValue();
+    const QByteArray number = QByteArray::number(value, 'g', 17);
+    put(number.constData(), number.size());
+}
+
+void JsonWriter::writeString(const QString &value)
+{
+    beginValue();
+    putString(value.utf16(), value.size());
+}
+
+void JsonWriter::writeString(const char *utf8, int size)
+{
+    writeString(QString::fromUtf8(utf8, size));
+}
+
+void JsonWriter::writeValue(const QVariant &value)
+{
+    switch (value.type()) {
+    case QVariant::Invalid:
+        writeNull();
+        break;
+    case QVariant::Bool:
+        writeBool(value.toBool());
+        break;
+    case QVariant::Int:
+    case QVariant::LongLong:
+        writeNumber(value.toLongLong());
+        break;
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+        writeNumber(value.toULongLong());
+        break;
+    case QVariant::Double:
+        writeNumber(value.toDouble());
+        break;
+    case QVariant::ByteArray: {
+        // as QString(QByteArray): utf-8 up to the first zero
+        const QByteArray bytes = value.toByteArray();
+        writeString(bytes.constData(), qstrnlen(bytes.constData(), bytes.size()));
+        break;
+    }
+    case QVariant::Map: {
+        const QVariantMap map = value.toMap();
+        beginObject();
+        for (QVariantMap::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+            writeKey(it.key().toUtf8().constData());
+            writeValue(it.value());
+        }
+        endObject();
+        break;
+    }
+    case QVariant::List: {
+        const QVariantList list = value.toList();
+        beginArray();
+        for (int i = 0; i < list.count(); ++i) {
+            writeValue(list.at(i));
+        }
+        endArray();
+        break;
+    }
+    default:
+        writeString(value.toString());
+        break;
+    }
+}
+
+void JsonWriter::endLine()
+{
+    put('\n');
+}
+
+bool JsonWriter::flush()
+{
+    if (m_used > 0 && !m_error) {
+        if (m_device->write(m_buffer.constData(), m_used) != m_used) {
+            m_error = true;
+        }
+    }
+    m_used = 0;
+
+    return !m_error;
+}
+
+void JsonWriter::put(const char *data, int size)
+{
+    while (size > 0) {
+        reserve(qMin(size, m_buffer.size()));
+        const int count = qMin(size, m_buffer.size() - m_used);
+        memcpy(m_buffer.data() + m_used, data, count);
+        m_used += count;
+        data += count;
+        size -= count;
+    }
+}
+
+void JsonWriter::beginValue()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+
+    if (!m_empty.isEmpty()) {
+        if (m_empty.last()) {
+            m_empty.last() = false;
+        }
+        else {
+            put(',');
+        }
+    }
+}
+
+void JsonWriter::putNumber(quint64 value)
+{
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    reserve(count);
+    char *out = m_buffer.data() + m_used;
+    for (int i = 0; i < count; ++i) {
+        out[i] = digits[count - i - 1];
+    }
+    m_used += count;
+}
+
+void JsonWriter::putString(const ushort *str, int size)
+{
+    put('"');
+    for (int i = 0; i < size; ++i) {
+        reserve(MAX_ESCAPED_CHAR_SIZE);
+        char *out = m_buffer.data() + m_used;
+        uint ch = str[i];
+        if (ch >= 0x20 && ch < 0x80) {
+            if (ch == '"' || ch == '\\') {
+                *out++ = '\\';
+            }
+            *out++ = ch;
+        }
+        else if (ch < 0x20) {
+            *out++ = '\\';
+            switch (ch) {
+            case '\b': *out++ = 'b'; break;
+            case '\f': *out++ = 'f'; break;
+            case '\n': *out++ = 'n'; break;
+            case '\r': *out++ = 'r'; break;
+            case '\t': *out++ = 't'; break;
+            default:
+                static const char hex[] = "0123456789abcdef";
+                *out++ = 'u';
+                *out++ = '0';
+                *out++ = '0';
+                *out++ = hex[ch >> 4];
+                *out++ = hex[ch & 0xF];
+                break;
+            }
+        }
+        else {
+            // the surrogate pair is combined into the one code point,
+            // the broken surrogate is replaced by U+FFFD
+            if (ch >= 0xD800 && ch <= 0xDBFF && i + 1 < size
+                    && str[i + 1] >= 0xDC00 && str[i + 1] <= 0xDFFF) {
+                ch = 0x10000 + ((ch - 0xD800) << 10) + (str[i + 1] - 0xDC00);
+                ++i;
+            }
+            else if (ch >= 0xD800 && ch <= 0xDFFF) {
+                ch = 0xFFFD;
+            }
+
+            if (ch < 0x800) {
+                *out++ = 0xC0 | (ch >> 6);
+                *out++ = 0x80 | (ch & 0x3F);
+            }
+            else if (ch < 0x10000) {
+                *out++ = 0xE0 | (ch >> 12);
+                *out++ = 0x80 | ((ch >> 6) & 0x3F);
+                *out++ = 0x80 | (ch & 0x3F);
+            }
+            else {
+                *out++ = 0xF0 | (ch >> 18);
+                *out++ = 0x80 | ((ch >> 12) & 0x3F);
+                *out++ = 0x80 | ((ch >> 6) & 0x3F);
+                *out++ = 0x80 | (ch & 0x3F);
+            }
+        }
+        m_used = out - m_buffer.data();
+    }
+
+    put('"');
+}
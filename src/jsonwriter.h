@@ -0,0 +1,103 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+
+// The streaming json writer. The values are escaped directly into the
+// buffer, the buffer is written to the device when it is full, so the
+// memory usage doesn't depend on the document size
+class JsonWriter
+{
+public:
+    explicit JsonWriter(QIODevice *device, int bufferSize = 1024 * 1024);
+    ~JsonWriter();
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    // the key of the next value inside the current object
+    void writeKey(const char *key);
+
+    void writeNull();
+    void writeBool(bool value);
+    inline void writeNumber(quint32 value);
+    void writeNumber(qint64 value);
+    void writeNumber(quint64 value);
+    void writeNumber(double value);
+    void writeString(const QString &value);
+    void writeString(const char *utf8, int size);
+    void writeValue(const QVariant &value);
+
+    // finishes the current line of the ndjson stream, the writer
+    // expects the next top-level value
+    void endLine();
+
+    bool flush();
+    inline bool hasError() const;
+
+private:
+    Q_DISABLE_COPY(JsonWriter)
+
+    inline void reserve(int size);
+    inline void put(char ch);
+    void put(const char *data, int size);
+    void putNumber(quint64 value);
+    void putString(const ushort *str, int size);
+    void beginValue();
+
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    int m_used;
+    bool m_error;
+    // true if the current object or array has no values yet
+    QVector<bool> m_empty;
+    bool m_afterKey;
+};
+
+void JsonWriter::writeNumber(quint32 value)
+{
+    writeNumber(static_cast<quint64>(value));
+}
+
+bool JsonWriter::hasError() const
+{
+    return m_error;
+}
+
+void JsonWriter::reserve(int size)
+{
+    if (m_used + size > m_buffer.size()) {
+        flush();
+    }
+}
+
+void JsonWriter::put(char ch)
+{
+    reserve(1);
+    m_buffer.data()[m_used++] = ch;
+}
+
+
+#endif // JSONWRITER_H
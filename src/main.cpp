@@ -12,9 +12,17 @@
 //
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "batchrecovery.h"
+#include "imagerecovery.h"
 #include "miranda.h"
+#include "progress.h"
+#include "recordindex.h"
+#include "textindex.h"
 #include <QtArgumentParser>
 #include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QThread>
 #include <iostream>
 
 
@@ -23,10 +31,161 @@ void printUsage()
     std::cout << "mirandadbrecovery v.1.0"              << std::endl
               << "    Recovery the miranda database"    << std::endl
               << "Usage:"                               << std::endl
-              << "    mirandadbrecovery -i miranda.db -o output.json [-v]" << std::endl
+              << "    mirandadbrecovery -i miranda.db -o output.json [-v] [-m [--huge-pages]] [-j N] [-f json|ndjson|bin] [-z gzip|zstd] [--shard contact|N] [--since T] [--until T] [--module M,...] [--contact ID,...] [--walk|--index] [--text-index] [--rescan-interior] [--include-weak] [--keep-duplicates] [--stats FILE] [--progress] [--status-file FILE]" << std::endl
+              << "    mirandadbrecovery --image /dev/sdX -o output.ndjson [-v] [-j N] [--include-weak]" << std::endl
+              << "    mirandadbrecovery --bin2json output.bin -o output.json [-f json|ndjson]" << std::endl
+              << "    mirandadbrecovery --build-index miranda.mri -i miranda.db [-v] [-m] [-j N] [--walk] [--rescan-interior] [--include-weak] [--keep-duplicates]" << std::endl
+              << "    mirandadbrecovery --query miranda.mri -i miranda.db -o output.ndjson [-z gzip|zstd] [--at OFFSET,...] [--contact ID,...] [--since T] [--until T] [--module M,...] [--last N]" << std::endl
+              << "    mirandadbrecovery --search output.json.txi --terms \"word word OR word\" [--since T] [--until T]" << std::endl
+              << "    mirandadbrecovery --batch manifest.txt [-j N] [options]"  << std::endl
+              << "    mirandadbrecovery --batch input_dir -o output_dir [-j N] [options]" << std::endl
               << "Options:"                             << std::endl
               << "    -i input miranda database"        << std::endl
-              << "    -o output json file"              << std::endl;
+              << "    -o output json file"              << std::endl
+              << "    -f output format: json (default), ndjson or bin (columns)" << std::endl
+              << "    -v verbose output"                << std::endl
+              << "    -m map the database into the memory instead of reading" << std::endl
+              << "    --huge-pages use huge pages for the mapped database"    << std::endl
+              << "    -j number of scanning threads (0 - number of cores)"    << std::endl
+              << "    --walk read the records by the links, carve only the damaged ranges" << std::endl
+              << "    --index keep the scan index in the output.idx file and" << std::endl
+              << "            rescan only the blocks changed since the last run" << std::endl
+              << "    --text-index keep the full-text index of the messages in" << std::endl
+              << "            the output.txi file"                             << std::endl
+              << "    -z compress the json or ndjson output by gzip or zstd"   << std::endl
+              << "            on the fly (zstd if it was found at the build)"   << std::endl
+              << "    --shard write the directory of the ndjson shards: the"   << std::endl
+              << "            events of each contact or of N events per file," << std::endl
+              << "            manifest.ndjson lists the contacts and the shards" << std::endl
+              << "    --since, --until select the events of [since, until), the" << std::endl
+              << "            unix time or the iso date, e.g. 2015-06-01"      << std::endl
+              << "    --module select the events of the modules, e.g. ICQ"     << std::endl
+              << "    --contact select the contacts by the ids of the output"  << std::endl
+              << "    --rescan-interior look for the records inside the blobs of" << std::endl
+              << "            the valid events and settings too (slower)"    << std::endl
+              << "    --include-weak write the records which failed the"       << std::endl
+              << "            validation too, the most of them are garbage"    << std::endl
+              << "    --keep-duplicates don't remove the stale copies of the"  << std::endl
+              << "            events left in the free space"                   << std::endl
+              << "    --schema the json file which describes the settings of"  << std::endl
+              << "            the accounts and the contacts in the output"     << std::endl
+              << "    --stats write the json report of the time of the phases" << std::endl
+              << "            and of the carving counters to the file, \"-\" is" << std::endl
+              << "            the standard error"                                << std::endl
+              << "    --progress show the progress, the speed and the ETA on"  << std::endl
+              << "            the standard error"                              << std::endl
+              << "    --status-file keep the progress in the json file, the"   << std::endl
+              << "            file is replaced each second"                    << std::endl
+              << "    --image carve the records out of the raw disk image or"  << std::endl
+              << "            the device of any size, the output is ndjson"     << std::endl
+              << "    --bin2json convert the bin output to the json output"    << std::endl
+              << "    --build-index recover the database and write the index of"  << std::endl
+              << "            the contacts and the events to the file"         << std::endl
+              << "    --query write the messages selected by the index as the" << std::endl
+              << "            ndjson events, only their blobs are read"        << std::endl
+              << "    --at select the events by the ids (the offsets) of the"  << std::endl
+              << "            output, the query only"                          << std::endl
+              << "    --last select the last N messages by the time, the"      << std::endl
+              << "            query only"                                      << std::endl
+              << "    --search print the ids of the messages which have the"   << std::endl
+              << "            --terms, the words are joined by AND, the"       << std::endl
+              << "            alternatives are separated by OR"                << std::endl
+              << "    --batch recover many databases: the directory with the"  << std::endl
+              << "            databases or the manifest with the lines"         << std::endl
+              << "            \"input<TAB>output\", -j is the number of the"   << std::endl
+              << "            databases recovered at the same time, the"       << std::endl
+              << "            number of the cores by default"                  << std::endl;
+}
+
+
+// the unix time or the iso date and time, the utc if the offset isn't
+// given
+bool parseTimestamp(const QString &value, DWORD *timestamp)
+{
+    bool ok = false;
+    *timestamp = value.toUInt(&ok);
+    if (ok) {
+        return true;
+    }
+
+    QDateTime dateTime = QDateTime::fromString(value, Qt::ISODate);
+    if (!dateTime.isValid()) {
+        return false;
+    }
+    if (dateTime.timeSpec() == Qt::LocalTime) {
+        dateTime.setTimeSpec(Qt::UTC);
+    }
+    *timestamp = dateTime.toTime_t();
+
+    return true;
+}
+
+
+int runBatch(const QString &batch, const QString &outputDir,
+             const Miranda2JsonOptions &options, int workerCount)
+{
+    QString suffix = ".json";
+    if (options.outputFormat == Miranda2JsonOptions::NdjsonFormat) {
+        suffix = ".ndjson";
+    }
+    else if (options.outputFormat == Miranda2JsonOptions::BinaryFormat) {
+        suffix = ".bin";
+    }
+    if (options.compression == GzipCompression) {
+        suffix += ".gz";
+    }
+    else if (options.compression == ZstdCompression) {
+        suffix += ".zst";
+    }
+    // the directory of the shards, see ShardedOutputVisitor
+    if (options.shardMode != Miranda2JsonOptions::NoShards) {
+        suffix = ".shards";
+    }
+
+    QVector<BatchJob> jobs;
+    if (QFileInfo(batch).isDir()) {
+        if (outputDir.isEmpty()) {
+            printUsage();
+            return -1;
+        }
+        if (!ReadBatchDirectory(batch, outputDir, suffix, &jobs)) {
+            return -1;
+        }
+    }
+    else if (!ReadBatchManifest(batch, &jobs)) {
+        return -1;
+    }
+
+    // the databases are recovered in parallel, each by the one thread,
+    // the verbose output and the reports of the parallel jobs would be
+    // mixed
+    Miranda2JsonOptions jobOptions = options;
+    jobOptions.verbose = false;
+    jobOptions.threadCount = 1;
+    jobOptions.statsFileName.clear();
+
+    std::cout << "== Summary ==" << std::endl;
+    std::cout << "  Batch           : " << batch.toStdString() << std::endl;
+    std::cout << "  Databases       : " << jobs.count() << std::endl;
+    std::cout << "  Parallel jobs   : " << workerCount << std::endl;
+
+    RunBatch(&jobs, jobOptions, workerCount);
+
+    int failed = 0;
+    std::cout << "== Results ==" << std::endl;
+    foreach (const BatchJob &job, jobs) {
+        if (!job.success) {
+            ++failed;
+        }
+        std::cout << "  " << (job.success ? "OK    " : "FAILED") << " "
+                  << job.inputFileName.toStdString() << " -> "
+                  << job.outputFileName.toStdString() << " ("
+                  << job.elapsed << " ms)" << std::endl;
+    }
+    std::cout << "  Succeeded       : " << jobs.count() - failed << std::endl;
+    std::cout << "  Failed          : " << failed << std::endl;
+
+    return failed ? 1 : 0;
 }
 
 
@@ -38,6 +197,35 @@ int main(int argc, char *argv[])
     parser.add("-i", QtArgumentParser::String);
     parser.add("-o", QtArgumentParser::String);
     parser.add("-v", QtArgumentParser::Flag);
+    parser.add("-m", QtArgumentParser::Flag);
+    parser.add("--huge-pages", QtArgumentParser::Flag);
+    parser.add("-j", QtArgumentParser::String);
+    parser.add("-f", QtArgumentParser::String);
+    parser.add("-z", QtArgumentParser::String);
+    parser.add("--shard", QtArgumentParser::String);
+    parser.add("--since", QtArgumentParser::String);
+    parser.add("--until", QtArgumentParser::String);
+    parser.add("--module", QtArgumentParser::String);
+    parser.add("--contact", QtArgumentParser::String);
+    parser.add("--walk", QtArgumentParser::Flag);
+    parser.add("--index", QtArgumentParser::Flag);
+    parser.add("--text-index", QtArgumentParser::Flag);
+    parser.add("--rescan-interior", QtArgumentParser::Flag);
+    parser.add("--include-weak", QtArgumentParser::Flag);
+    parser.add("--keep-duplicates", QtArgumentParser::Flag);
+    parser.add("--batch", QtArgumentParser::String);
+    parser.add("--bin2json", QtArgumentParser::String);
+    parser.add("--image", QtArgumentParser::String);
+    parser.add("--build-index", QtArgumentParser::String);
+    parser.add("--query", QtArgumentParser::String);
+    parser.add("--at", QtArgumentParser::String);
+    parser.add("--last", QtArgumentParser::String);
+    parser.add("--search", QtArgumentParser::String);
+    parser.add("--terms", QtArgumentParser::String);
+    parser.add("--schema", QtArgumentParser::String);
+    parser.add("--stats", QtArgumentParser::String);
+    parser.add("--progress", QtArgumentParser::Flag);
+    parser.add("--status-file", QtArgumentParser::String);
 
     if (!parser.parse()) {
         std::cout << "cannot parse the arguments: "
@@ -47,6 +235,200 @@ int main(int argc, char *argv[])
     }
 
     QVariantMap map = parser.result();
+    Miranda2JsonOptions options;
+    options.verbose = map.value("-v").toBool();
+    options.mapInput = map.value("-m").toBool();
+    options.hugePages = map.value("--huge-pages").toBool();
+    options.walkChains = map.value("--walk").toBool();
+    options.scanIndex = map.value("--index").toBool();
+    options.textIndex = map.value("--text-index").toBool();
+    options.rescanInterior = map.value("--rescan-interior").toBool();
+    options.includeWeak = map.value("--include-weak").toBool();
+    options.keepDuplicates = map.value("--keep-duplicates").toBool();
+    options.schemaFileName = map.value("--schema").toString();
+    options.statsFileName = map.value("--stats").toString();
+    if (map.contains("-f")) {
+        const QString format = map.value("-f").toString();
+        if (format == "json") {
+            options.outputFormat = Miranda2JsonOptions::JsonFormat;
+        }
+        else if (format == "ndjson") {
+            options.outputFormat = Miranda2JsonOptions::NdjsonFormat;
+        }
+        else if (format == "bin") {
+            options.outputFormat = Miranda2JsonOptions::BinaryFormat;
+        }
+        else {
+            printUsage();
+            return -1;
+        }
+    }
+    if (map.contains("-z")) {
+        const QString compression = map.value("-z").toString();
+        if (compression == "gzip") {
+            options.compression = GzipCompression;
+        }
+        else if (compression == "zstd") {
+            options.compression = ZstdCompression;
+        }
+        else {
+            printUsage();
+            return -1;
+        }
+        if (!IsCompressionSupported(options.compression)) {
+            std::cerr << "the compression isn't supported by this build: "
+                      << compression.toStdString() << std::endl;
+            return -1;
+        }
+        // the bin output is mapped by the reader
+        if (options.outputFormat == Miranda2JsonOptions::BinaryFormat) {
+            printUsage();
+            return -1;
+        }
+    }
+    if (map.contains("--shard")) {
+        const QString shard = map.value("--shard").toString();
+        bool ok = true;
+        if (shard == "contact") {
+            options.shardMode = Miranda2JsonOptions::ContactShards;
+        }
+        else {
+            options.shardMode = Miranda2JsonOptions::CountShards;
+            options.shardSize = shard.toInt(&ok);
+            ok = ok && options.shardSize > 0;
+        }
+        if (!ok
+                || options.outputFormat == Miranda2JsonOptions::BinaryFormat) {
+            printUsage();
+            return -1;
+        }
+    }
+    if ((map.contains("--since")
+         && !parseTimestamp(map.value("--since").toString(), &options.filter.since))
+            || (map.contains("--until")
+                && !parseTimestamp(map.value("--until").toString(), &options.filter.until))) {
+        printUsage();
+        return -1;
+    }
+    if (map.contains("--module")) {
+        const QStringList names = map.value("--module").toString().split(',', QString::SkipEmptyParts);
+        foreach (const QString &name, names) {
+            options.filter.moduleNames.append(name.toUtf8());
+        }
+    }
+    if (map.contains("--contact")) {
+        const QStringList ids = map.value("--contact").toString().split(',', QString::SkipEmptyParts);
+        foreach (const QString &id, ids) {
+            bool ok = false;
+            options.filter.contactIds.insert(id.toUInt(&ok));
+            if (!ok) {
+                printUsage();
+                return -1;
+            }
+        }
+    }
+    if (map.contains("-j")) {
+        bool ok = false;
+        options.threadCount = map.value("-j").toString().toInt(&ok);
+        if (!ok || options.threadCount < 0) {
+            printUsage();
+            return -1;
+        }
+        if (options.threadCount == 0) {
+            options.threadCount = QThread::idealThreadCount();
+        }
+    }
+
+    // the first interrupt stops the recovery and writes the records which
+    // are already found, the reporter shows the last state when it's
+    // destroyed
+    InstallStopHandler();
+    ProgressReporter progress(map.value("--progress").toBool(),
+                              map.value("--status-file").toString());
+    progress.start();
+
+    if (map.contains("--build-index")) {
+        if (!map.contains("-i")) {
+            printUsage();
+            return -1;
+        }
+        return BuildRecordIndex(map.value("-i").toString(),
+                                map.value("--build-index").toString(), options) ? 0 : -1;
+    }
+
+    if (map.contains("--query")) {
+        RecordQuery query;
+        query.filter = options.filter;
+        if (map.contains("--at")) {
+            const QStringList offsets = map.value("--at").toString().split(',', QString::SkipEmptyParts);
+            foreach (const QString &offset, offsets) {
+                bool ok = false;
+                query.offsets.append(offset.toUInt(&ok));
+                if (!ok) {
+                    printUsage();
+                    return -1;
+                }
+            }
+        }
+        if (map.contains("--last")) {
+            bool ok = false;
+            query.last = map.value("--last").toString().toInt(&ok);
+            if (!ok || query.last <= 0) {
+                printUsage();
+                return -1;
+            }
+        }
+        if (!map.contains("-i") || !map.contains("-o")) {
+            printUsage();
+            return -1;
+        }
+        return QueryRecordIndex(map.value("--query").toString(), map.value("-i").toString(),
+                                map.value("-o").toString(), query, options) ? 0 : -1;
+    }
+
+    if (map.contains("--search")) {
+        if (!map.contains("--terms")) {
+            printUsage();
+            return -1;
+        }
+        QVector<DWORD> ids;
+        if (!SearchTextIndex(map.value("--search").toString(), map.value("--terms").toString(),
+                             options.filter, &ids)) {
+            return -1;
+        }
+        foreach (const DWORD id, ids) {
+            std::cout << id << std::endl;
+        }
+        return 0;
+    }
+
+    if (map.contains("--image")) {
+        if (!map.contains("-o")) {
+            printUsage();
+            return -1;
+        }
+        return image2json(map.value("--image").toString(),
+                          map.value("-o").toString(), options) ? 0 : -1;
+    }
+
+    if (map.contains("--bin2json")) {
+        if (!map.contains("-o")
+                || options.outputFormat == Miranda2JsonOptions::BinaryFormat) {
+            printUsage();
+            return -1;
+        }
+        return binary2json(map.value("--bin2json").toString(),
+                           map.value("-o").toString(), options) ? 0 : -1;
+    }
+
+    if (map.contains("--batch")) {
+        // the batch runs the one job per core unless -j is given
+        const int workerCount = map.contains("-j") ? options.threadCount
+                                                   : QThread::idealThreadCount();
+        return runBatch(map.value("--batch").toString(),
+                        map.value("-o").toString(), options, workerCount);
+    }
+
     if (!map.contains("-i") || !map.contains("-o")) {
         printUsage();
         return -1;
@@ -54,14 +436,15 @@ int main(int argc, char *argv[])
 
     const QString input = map.value("-i").toString();
     const QString output = map.value("-o").toString();
-    const bool verbose = map.value("-v").toBool();
 
     std::cout << "== Summary ==" << std::endl;
     std::cout << "  Miranda database: " << input.toStdString() << std::endl;
-    std::cout << "  Output json file: " << output.toStdString() << std::endl;
-    std::cout << "  Verbose         : " << (verbose ? "true" : "false") << std::endl;
+    std::cout << "  Output file     : " << output.toStdString() << std::endl;
+    std::cout << "  Verbose         : " << (options.verbose ? "true" : "false") << std::endl;
+    std::cout << "  Mapped input    : " << (options.mapInput ? "true" : "false") << std::endl;
+    std::cout << "  Threads         : " << options.threadCount << std::endl;
 
-    if (miranda2json(input, output, verbose)) {
+    if (miranda2json(input, output, options)) {
         return 0;
     }
 
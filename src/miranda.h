@@ -16,12 +16,69 @@
 #define MIRANDA_H
 
 
+#include "compressedfile.h"
+#include "recordfilter.h"
 #include <QString>
 
 
+struct Miranda2JsonOptions {
+    enum OutputFormat {
+        JsonFormat,     // the one json document
+        NdjsonFormat,   // the one json value per line
+        BinaryFormat    // the columns, see binaryformat.h
+    };
+
+    enum ShardMode {
+        NoShards,       // the one output file
+        ContactShards,  // the events of each contact chain in own file
+        CountShards     // the files of shardSize events
+    };
+
+    Miranda2JsonOptions()
+        : verbose(false), mapInput(false), hugePages(false), threadCount(1),
+          outputFormat(JsonFormat), walkChains(false), scanIndex(false),
+          rescanInterior(false), includeWeak(false), keepDuplicates(false),
+          compression(NoCompression), shardMode(NoShards), shardSize(0),
+          textIndex(false) {}
+
+    bool verbose;
+    bool mapInput;      // map the database into the memory instead of reading
+    bool hugePages;     // advise the kernel to use huge pages for the mapping
+    int threadCount;    // number of threads for the brutforce scanning
+    OutputFormat outputFormat;
+    bool walkChains;    // read the records by the links, carve only the gaps
+    bool scanIndex;     // keep the scan index and carve only the changed
+                        // blocks on the next run
+    QString indexFileName;  // the scan index, miranda2json keeps it next to
+                            // the output if it isn't set
+    bool rescanInterior;    // scan the interior of the strong records too
+    bool includeWeak;       // write the weak records too, see recordvalidator.h
+    bool keepDuplicates;    // keep the stale copies of the events
+    QString schemaFileName; // the extraction schema, empty - the default one
+    RecordFilter filter;    // the selected events and contacts
+    OutputCompression compression;  // the json and ndjson outputs only
+    ShardMode shardMode;    // the output is the directory of the ndjson
+    int shardSize;          // shards, see ShardedOutputVisitor
+    bool textIndex;     // write the full-text index of the messages
+    QString textIndexFileName;  // the text index, miranda2json keeps it next
+                                // to the output if it isn't set
+    QString statsFileName;  // the json report of the phases and the counters,
+                            // "-" - the standard error, empty - no report
+};
+
+
+bool miranda2json(const QString &inputFileName,
+                  const QString &outputFileName,
+                  const Miranda2JsonOptions &options);
 bool miranda2json(const QString &inputFileName,
                   const QString &outputFileName,
                   bool verbose = false);
 
+// Converts the binary output to the json or ndjson output, the result
+// is the same as the output of miranda2json in that format
+bool binary2json(const QString &binaryFileName,
+                 const QString &outputFileName,
+                 const Miranda2JsonOptions &options);
+
 
 #endif // MIRANDA_H
@@ -0,0 +1,139 @@
+// Copyright 2013-2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//                2011, Ruslan Nigmatullin <euroelessar@yandex.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "mirandadb.h"
+
+
+void WriteDWord(QByteArray *data, DWORD value)
+{
+    data->append(static_cast<char>(value & 0xFF));
+    data->append(static_cast<char>((value >> 8) & 0xFF));
+    data->append(static_cast<char>((value >> 16) & 0xFF));
+    data->append(static_cast<char>((value >> 24) & 0xFF));
+}
+
+
+void WriteQWord(QByteArray *data, quint64 value)
+{
+    WriteDWord(data, static_cast<DWORD>(value));
+    WriteDWord(data, static_cast<DWORD>(value >> 32));
+}
+
+
+DBHeader ReadDBHeader(const BYTE *data)
+{
+    DBHeader header;
+    for (int i = 0; i < 16; i++) {
+        header.signature[i] = ReadByte(data);
+    }
+    header.version = ReadDWord(data);
+    header.ofsFileEnd = ReadDWord(data);
+    header.slackSpace = ReadDWord(data);
+    header.contactCount = ReadDWord(data);
+    header.ofsFirstContact = ReadDWord(data);
+    header.ofsUser = ReadDWord(data);
+    header.ofsFirstModuleName = ReadDWord(data);
+
+    return header;
+}
+
+
+DBContact ReadDBContact(const BYTE *data, const BYTE *lastDataAddr)
+{
+    if ((lastDataAddr - data) < 32) {
+        throw QString("invalid data format");
+    }
+
+    DBContact contact;
+    contact.signature = ReadDWord(data);
+    contact.ofsNext = ReadDWord(data);
+    contact.ofsFirstSettings = ReadDWord(data);
+    contact.eventCount = ReadDWord(data);
+    contact.ofsFirstEvent = ReadDWord(data);
+    contact.ofsLastEvent = ReadDWord(data);
+    contact.ofsFirstUnreadEvent = ReadDWord(data);
+    contact.timestampFirstUnread = ReadDWord(data);
+
+    return contact;
+}
+
+
+DBEvent ReadDBEvent(const BYTE *firstDataAddr, const BYTE *data,
+                    const BYTE *lastDataAddr)
+{
+    if ((lastDataAddr - data) < 32) {
+        throw QString("invalid data format");
+    }
+
+    DBEvent event;
+    event.signature = ReadDWord(data);
+    event.ofsPrev = ReadDWord(data);
+    event.ofsNext = ReadDWord(data);
+    event.ofsModuleName = ReadDWord(data);
+    event.timestamp = ReadDWord(data);
+    event.flags = ReadDWord(data);
+    event.eventType = ReadWord(data);
+    event.cbBlob = ReadDWord(data);
+    if (event.cbBlob > (lastDataAddr - data)) {
+        throw QString("invalid data format");
+    }
+    event.blob = MakeView(firstDataAddr, data, event.cbBlob);
+    event.moduleId = UNKNOWN_MODULE_ID;
+
+    return event;
+}
+
+
+DBModuleName ReadDBModuleName(const BYTE *firstAddr, const BYTE *data,
+                              const BYTE *lastAddr)
+{
+    if ((lastAddr - data) < 9) {
+        throw QString("invalid data format");
+    }
+
+    DBModuleName moduleName;
+    moduleName.signature = ReadDWord(data);
+    moduleName.ofsNext = ReadDWord(data);
+    moduleName.cbName = ReadByte(data);
+    if (moduleName.cbName > (lastAddr - data)) {
+        throw QString("invalid data format");
+    }
+    moduleName.name = MakeView(firstAddr, data, moduleName.cbName);
+
+    return moduleName;
+}
+
+
+DBContactSettings ReadDBContactSettings(const BYTE *firstAddr,
+                                        const BYTE *data,
+                                        const BYTE *lastAddr)
+{
+    if ((lastAddr - data) < 16) {
+        throw QString("invalid data format");
+    }
+
+    DBContactSettings settings;
+    settings.signature = ReadDWord(data);
+    settings.ofsNext = ReadDWord(data);
+    settings.ofsModuleName = ReadDWord(data);
+    settings.cbBlob = ReadDWord(data);
+    if (settings.cbBlob > (lastAddr - data)) {
+        throw QString("invalid data format");
+    }
+    settings.blob = MakeView(firstAddr, data, settings.cbBlob);
+    settings.moduleId = UNKNOWN_MODULE_ID;
+
+    return settings;
+}
@@ -0,0 +1,94 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "mirandadbimage.h"
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+
+// all offsets inside the miranda database are 32-bit
+static const qint64 MAX_IMAGE_SIZE = Q_INT64_C(0xFFFFFFFF);
+
+
+MirandaDbImage::MirandaDbImage()
+    : m_map(0), m_data(0), m_size(0)
+{
+}
+
+MirandaDbImage::~MirandaDbImage()
+{
+    close();
+}
+
+bool MirandaDbImage::open(const QString &fileName, bool map, bool hugePages)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    if (size > MAX_IMAGE_SIZE) {
+        m_errorString = "the database is larger than 4GB";
+        close();
+        return false;
+    }
+
+    // the mapping is impossible for the empty file and for the
+    // special files (pipes, character devices), in that case we
+    // read the file into the memory
+    if (map && size > 0) {
+        m_map = m_file.map(0, size);
+    }
+
+    if (m_map) {
+#ifdef Q_OS_UNIX
+        // the brutforce scanner reads the database from the begin to
+        // the end, so the kernel may read ahead more aggressively
+        madvise(m_map, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        if (hugePages) {
+            madvise(m_map, size, MADV_HUGEPAGE);
+        }
+#endif
+#endif
+        Q_UNUSED(hugePages);
+        m_data = m_map;
+        m_size = size;
+    }
+    else {
+        m_bytes = m_file.readAll();
+        m_data = (const uchar *)m_bytes.constData();
+        m_size = m_bytes.size();
+    }
+
+    return true;
+}
+
+void MirandaDbImage::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = 0;
+    }
+
+    m_file.close();
+    m_bytes.clear();
+    m_data = 0;
+    m_size = 0;
+}
@@ -0,0 +1,73 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef MIRANDADBIMAGE_H
+#define MIRANDADBIMAGE_H
+
+
+#include <QFile>
+#include <QByteArray>
+#include <QString>
+
+
+// The read-only image of the miranda database. The image is either
+// mapped into the memory (the pages are loaded on demand by the kernel)
+// or read into the memory entirely
+class MirandaDbImage
+{
+public:
+    MirandaDbImage();
+    ~MirandaDbImage();
+
+    bool open(const QString &fileName, bool map = false, bool hugePages = false);
+    void close();
+
+    inline const uchar *data() const;
+    inline qint64 size() const;
+    inline bool isMapped() const;
+    inline const QString &errorString() const;
+
+private:
+    Q_DISABLE_COPY(MirandaDbImage)
+
+    QFile m_file;
+    QByteArray m_bytes;
+    uchar *m_map;
+    const uchar *m_data;
+    qint64 m_size;
+    QString m_errorString;
+};
+
+const uchar *MirandaDbImage::data() const
+{
+    return m_data;
+}
+
+qint64 MirandaDbImage::size() const
+{
+    return m_size;
+}
+
+bool MirandaDbImage::isMapped() const
+{
+    return m_map != 0;
+}
+
+const QString &MirandaDbImage::errorString() const
+{
+    return m_errorString;
+}
+
+
+#endif // MIRANDADBIMAGE_H
@@ -0,0 +1,56 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "modulenametable.h"
+
+
+// the ids are 16-bit
+static const int MAX_MODULE_COUNT = 0x10000;
+
+
+ModuleNameTable::ModuleNameTable()
+{
+    m_names.append(QString());
+}
+
+void ModuleNameTable::build(const BYTE *firstDataAddr,
+                            const RecordTable<DBModuleName> &moduleNames)
+{
+    m_names.clear();
+    m_names.append(QString());
+    m_idByOffset.clear();
+
+    // the ids are given in the order of the offsets, so they are the
+    // same for the same database. The moved module leaves the stale copy
+    // of its DBModuleName, all copies of the name get the same id
+    QHash<QString, WORD> idByName;
+    for (int i = 0; i < moduleNames.count(); ++i) {
+        const DWORD offset = moduleNames.offset(i);
+        const DBView &view = moduleNames.at(i).name;
+        const QString name = QString::fromUtf8((const char *)ViewData(firstDataAddr, view),
+                                               ViewStringSize(firstDataAddr, view));
+
+        WORD id = idByName.value(name, UNKNOWN_MODULE_ID);
+        if (id == UNKNOWN_MODULE_ID) {
+            if (m_names.count() >= MAX_MODULE_COUNT) {
+                continue;
+            }
+            id = m_names.count();
+            m_names.append(name);
+            idByName.insert(name, id);
+        }
+
+        m_idByOffset.insert(offset, id);
+    }
+}
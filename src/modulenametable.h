@@ -0,0 +1,62 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef MODULENAMETABLE_H
+#define MODULENAMETABLE_H
+
+
+#include "mirandadb.h"
+#include "recordtable.h"
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+
+// The module names interned after the scan. The database has a few
+// dozens of modules but millions of events, so the events and the
+// settings keep the 16-bit id of the module and share its name
+class ModuleNameTable
+{
+public:
+    ModuleNameTable();
+
+    void build(const BYTE *firstDataAddr,
+               const RecordTable<DBModuleName> &moduleNames);
+
+    inline WORD idByOffset(DWORD ofsModuleName) const;
+    inline const QString &name(WORD id) const;
+    inline int count() const;
+
+private:
+    QVector<QString> m_names;
+    QHash<DWORD, WORD> m_idByOffset;
+};
+
+WORD ModuleNameTable::idByOffset(DWORD ofsModuleName) const
+{
+    return m_idByOffset.value(ofsModuleName, UNKNOWN_MODULE_ID);
+}
+
+const QString &ModuleNameTable::name(WORD id) const
+{
+    return m_names.at(id);
+}
+
+int ModuleNameTable::count() const
+{
+    return m_names.count();
+}
+
+
+#endif // MODULENAMETABLE_H
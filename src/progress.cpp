@@ -0,0 +1,266 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "progress.h"
+#include "jsonwriter.h"
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QSaveFile>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+
+static QAtomicInteger<qint64> g_totalBytes;
+static QAtomicInteger<qint64> g_scannedBytes;
+static QAtomicInteger<qint64> g_records;
+static QAtomicInteger<qint64> g_totalEvents;
+static QAtomicInteger<qint64> g_writtenEvents;
+static QAtomicInt g_stopRequested;
+
+
+void ProgressAddTotalBytes(qint64 bytes)
+{
+    g_totalBytes.fetchAndAddRelaxed(bytes);
+}
+
+
+void ProgressAddScannedBytes(qint64 bytes)
+{
+    g_scannedBytes.fetchAndAddRelaxed(bytes);
+}
+
+
+void ProgressAddRecords(qint64 count)
+{
+    g_records.fetchAndAddRelaxed(count);
+}
+
+
+void ProgressAddTotalEvents(qint64 count)
+{
+    g_totalEvents.fetchAndAddRelaxed(count);
+}
+
+
+void ProgressAddWrittenEvents(qint64 count)
+{
+    g_writtenEvents.fetchAndAddRelaxed(count);
+}
+
+
+ProgressSnapshot ReadProgress()
+{
+    ProgressSnapshot snapshot;
+    snapshot.totalBytes = g_totalBytes.load();
+    snapshot.scannedBytes = g_scannedBytes.load();
+    snapshot.records = g_records.load();
+    snapshot.totalEvents = g_totalEvents.load();
+    snapshot.writtenEvents = g_writtenEvents.load();
+
+    return snapshot;
+}
+
+
+static void StopHandler(int)
+{
+    // the second interrupt kills the process
+    g_stopRequested.store(1);
+    signal(SIGINT, SIG_DFL);
+}
+
+
+void InstallStopHandler()
+{
+    signal(SIGINT, StopHandler);
+}
+
+
+void RequestStop()
+{
+    g_stopRequested.store(1);
+}
+
+
+bool IsStopRequested()
+{
+    return g_stopRequested.load() != 0;
+}
+
+
+class ProgressReporter::Task : public QRunnable
+{
+public:
+    explicit Task(ProgressReporter *reporter) : m_reporter(reporter) {}
+
+    void run()
+    {
+        m_reporter->run();
+    }
+
+private:
+    ProgressReporter *m_reporter;
+};
+
+
+ProgressReporter::ProgressReporter(bool terminal, const QString &statusFileName,
+                                   int interval)
+    : m_terminal(terminal), m_isatty(false), m_statusFileName(statusFileName),
+      m_interval(interval), m_stopped(false), m_last(ReadProgress()),
+      m_lastElapsed(0)
+{
+    m_pool.setMaxThreadCount(1);
+#ifdef Q_OS_UNIX
+    m_isatty = isatty(fileno(stderr));
+#endif
+}
+
+
+ProgressReporter::~ProgressReporter()
+{
+    stop();
+}
+
+
+void ProgressReporter::start()
+{
+    if (m_terminal || !m_statusFileName.isEmpty()) {
+        m_pool.start(new Task(this));
+    }
+}
+
+
+void ProgressReporter::stop()
+{
+    m_mutex.lock();
+    m_stopped = true;
+    m_condition.wakeAll();
+    m_mutex.unlock();
+
+    m_pool.waitForDone();
+}
+
+
+void ProgressReporter::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_mutex.lock();
+    while (!m_stopped) {
+        m_condition.wait(&m_mutex, m_interval);
+        if (!m_stopped) {
+            m_mutex.unlock();
+            report(timer.elapsed(), false);
+            m_mutex.lock();
+        }
+    }
+    m_mutex.unlock();
+
+    report(timer.elapsed(), true);
+}
+
+
+void ProgressReporter::report(qint64 elapsed, bool finished)
+{
+    const ProgressSnapshot current = ReadProgress();
+
+    // the rate is measured by the last interval, the events are written
+    // after the scan, so the eta is of the running phase
+    const double seconds = qMax<qint64>(1, elapsed - m_lastElapsed) / 1000.0;
+    const double bytesPerSecond = (current.scannedBytes - m_last.scannedBytes) / seconds;
+    const double eventsPerSecond = (current.writtenEvents - m_last.writtenEvents) / seconds;
+    const bool writing = current.totalEvents > 0;
+    qint64 eta = -1;
+    if (!writing && bytesPerSecond > 0 && current.totalBytes > current.scannedBytes) {
+        eta = (current.totalBytes - current.scannedBytes) / bytesPerSecond;
+    }
+    else if (writing && eventsPerSecond > 0 && current.totalEvents > current.writtenEvents) {
+        eta = (current.totalEvents - current.writtenEvents) / eventsPerSecond;
+    }
+    m_last = current;
+    m_lastElapsed = elapsed;
+
+    QString state = writing ? "writing" : "scanning";
+    if (finished) {
+        state = IsStopRequested() ? "interrupted" : "finished";
+    }
+
+    if (m_terminal) {
+        QString line = QString("%1: %2/%3 MB, %4 MB/s, %5 records")
+                .arg(state)
+                .arg(current.scannedBytes / (1024 * 1024))
+                .arg(current.totalBytes / (1024 * 1024))
+                .arg(bytesPerSecond / (1024 * 1024), 0, 'f', 1)
+                .arg(current.records);
+        if (writing) {
+            line += QString(", %1/%2 events").arg(current.writtenEvents).arg(current.totalEvents);
+        }
+        if (eta >= 0) {
+            line += QString(", ETA %1 s").arg(eta);
+        }
+        if (!m_isatty) {
+            std::cerr << line.toStdString() << std::endl;
+        }
+        else {
+            // the previous line may be longer
+            std::cerr << "\r" << line.toStdString() << "   ";
+            if (finished) {
+                std::cerr << std::endl;
+            }
+            else {
+                std::cerr.flush();
+            }
+        }
+    }
+
+    if (!m_statusFileName.isEmpty()) {
+        QSaveFile file(m_statusFileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            return;
+        }
+
+        JsonWriter writer(&file, 4096);
+        writer.beginObject();
+        writer.writeKey("state");
+        writer.writeString(state);
+        writer.writeKey("elapsed_ms");
+        writer.writeNumber(elapsed);
+        writer.writeKey("total_bytes");
+        writer.writeNumber(current.totalBytes);
+        writer.writeKey("scanned_bytes");
+        writer.writeNumber(current.scannedBytes);
+        writer.writeKey("records");
+        writer.writeNumber(current.records);
+        writer.writeKey("total_events");
+        writer.writeNumber(current.totalEvents);
+        writer.writeKey("written_events");
+        writer.writeNumber(current.writtenEvents);
+        writer.writeKey("bytes_per_second");
+        writer.writeNumber(bytesPerSecond);
+        writer.writeKey("events_per_second");
+        writer.writeNumber(eventsPerSecond);
+        writer.writeKey("eta_seconds");
+        writer.writeNumber(eta);
+        writer.endObject();
+        writer.endLine();
+        if (writer.flush()) {
+            file.commit();
+        }
+    }
+}
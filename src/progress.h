@@ -0,0 +1,88 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+
+// The counters of the running recoveries. The scanners and the writers
+// add to them without the locks, once per the slice of the image or per
+// the event, the reporter reads them in the background. The counters
+// are shared by all recoveries of the process, so the batch shows the
+// total progress
+void ProgressAddTotalBytes(qint64 bytes);
+void ProgressAddScannedBytes(qint64 bytes);
+void ProgressAddRecords(qint64 count);
+void ProgressAddTotalEvents(qint64 count);
+void ProgressAddWrittenEvents(qint64 count);
+
+struct ProgressSnapshot {
+    qint64 totalBytes;
+    qint64 scannedBytes;
+    qint64 records;
+    qint64 totalEvents;
+    qint64 writtenEvents;
+};
+
+ProgressSnapshot ReadProgress();
+
+
+// The scanners stop at the next slice when the stop is requested, all the
+// records which are already found are written
+void InstallStopHandler();
+void RequestStop();
+bool IsStopRequested();
+
+
+// Reports the progress each interval to the line on the standard error
+// and/or to the status file, which is replaced atomically, so the
+// supervisor always reads the complete json
+class ProgressReporter
+{
+public:
+    ProgressReporter(bool terminal, const QString &statusFileName,
+                     int interval = 1000);
+    ~ProgressReporter();
+
+    void start();
+    void stop();
+
+private:
+    Q_DISABLE_COPY(ProgressReporter)
+
+    class Task;
+
+    void run();
+    void report(qint64 elapsed, bool finished);
+
+    bool m_terminal;
+    bool m_isatty;          // the line is rewritten, else the lines are appended
+    QString m_statusFileName;
+    int m_interval;
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    bool m_stopped;
+    ProgressSnapshot m_last;
+    qint64 m_lastElapsed;
+};
+
+
+#endif // PROGRESS_H
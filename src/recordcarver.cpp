@@ -0,0 +1,493 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recordcarver.h"
+#include "progress.h"
+#include "recordvalidator.h"
+#include "signaturescanner.h"
+#include <QRunnable>
+#include <QThreadPool>
+#include <algorithm>
+
+
+// the chunks smaller than this are not worth a separate thread
+static const qint64 MIN_CHUNK_SIZE = 1024 * 1024;
+
+// the progress is reported and the stop is checked once per slice, so
+// the scan loop doesn't touch the shared counters
+static const qint64 PROGRESS_SLICE_SIZE = 4 * 1024 * 1024;
+
+
+// the size of DBContact in the image
+static const DWORD DBCONTACT_RECORD_SIZE = 32;
+
+// the scan doesn't jump over the larger records, their size is more
+// likely the damaged cbBlob than the real blob
+static const qint64 MAX_SKIPPED_RECORD_SIZE = 1024 * 1024;
+
+// the parallel chunk keeps the signatures of its beginning even if they
+// aren't needed, the chunk is resynced on them, see ResyncChunk()
+static const qint64 RESYNC_WINDOW_SIZE = 4 * MAX_SKIPPED_RECORD_SIZE;
+
+
+class CarveTask : public QRunnable
+{
+public:
+    CarveTask(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+              qint64 from, qint64 to, const CarveOptions &options,
+              CarvedRecords *records)
+        : m_firstDataAddr(firstDataAddr), m_lastDataAddr(lastDataAddr),
+          m_from(from), m_to(to), m_options(options), m_records(records)
+    {
+    }
+
+    void run()
+    {
+        CarveRecords(m_firstDataAddr, m_lastDataAddr, m_from, m_to,
+                     m_options, m_records);
+    }
+
+private:
+    const BYTE *m_firstDataAddr;
+    const BYTE *m_lastDataAddr;
+    qint64 m_from;
+    qint64 m_to;
+    CarveOptions m_options;
+    CarvedRecords *m_records;
+};
+
+
+CarveCounters::CarveCounters()
+{
+    for (int i = 0; i < RecordTypeCount; ++i) {
+        hits[i] = 0;
+        failures[i] = 0;
+        weak[i] = 0;
+        filtered[i] = 0;
+    }
+}
+
+void CarveCounters::add(const CarveCounters &other)
+{
+    for (int i = 0; i < RecordTypeCount; ++i) {
+        hits[i] += other.hits[i];
+        failures[i] += other.failures[i];
+        weak[i] += other.weak[i];
+        filtered[i] += other.filtered[i];
+    }
+}
+
+
+static RecordType RecordTypeOf(DWORD signature)
+{
+    switch (signature) {
+    case DBCONTACT_SIGNATURE:
+        return ContactRecord;
+    case DBEVENT_SIGNATURE:
+        return EventRecord;
+    case DBMODULENAME_SIGNATURE:
+        return ModuleNameRecord;
+    case DBCONTACTSETTINGS_SIGNATURE:
+        return ContactSettingsRecord;
+    }
+
+    return RecordTypeCount;
+}
+
+
+static void MergeOffsets(const QVector<DWORD> &from, QVector<DWORD> *to)
+{
+    const int middle = to->count();
+    *to += from;
+    std::inplace_merge(to->begin(), to->begin() + middle, to->end());
+}
+
+
+static int RecordCount(const CarvedRecords &records)
+{
+    return records.contacts.count() + records.events.count()
+            + records.moduleNames.count() + records.contactSettings.count();
+}
+
+
+void CarveRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                  qint64 from, qint64 to, const CarveOptions &options,
+                  CarvedRecords *records)
+{
+    const qint64 dataSize = lastDataAddr - firstDataAddr;
+    qint64 next = from;
+    for (qint64 sliceFrom = from; sliceFrom < to; sliceFrom += PROGRESS_SLICE_SIZE) {
+        if (IsStopRequested()) {
+            break;
+        }
+
+        // the signature which begins at (sliceTo - 1) ends at (sliceTo + 3)
+        const qint64 sliceTo = qMin(sliceFrom + PROGRESS_SLICE_SIZE, to);
+        const qint64 scanSize = qMin(sliceTo + 3, dataSize);
+        const int recordCount = RecordCount(*records);
+
+        qint64 pos = FindRecordSignature(firstDataAddr, qMax(next, sliceFrom), scanSize);
+        while (pos < sliceTo && pos < scanSize) {
+            if (options.keepSignatures || pos < from + RESYNC_WINDOW_SIZE) {
+                records->signatures.append(pos);
+            }
+            next = ReadRecordAt(firstDataAddr, lastDataAddr, pos, options, records);
+            pos = (next < scanSize) ? FindRecordSignature(firstDataAddr, next, scanSize) : scanSize;
+        }
+
+        ProgressAddScannedBytes(sliceTo - sliceFrom);
+        ProgressAddRecords(RecordCount(*records) - recordCount);
+    }
+
+    records->scanEnd = qMax(next, to);
+}
+
+
+// The end of the record where the scan may continue, the next byte if
+// the size of the record isn't trusted: cbBlob is checked only against
+// the end of the image, so the scan jumps over the record only if it is
+// of the sane size and the next record or the end of the image begins
+// right after it; the records are allocated one after another
+static qint64 VerifiedRecordEnd(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                DWORD offset, qint64 end)
+{
+    const qint64 dataSize = lastDataAddr - firstDataAddr;
+    if (end - offset > MAX_SKIPPED_RECORD_SIZE) {
+        return offset + 1;
+    }
+    if (end == dataSize) {
+        return end;
+    }
+    if (end + 4 > dataSize || RecordTypeOf(ReadSignature(firstDataAddr + end)) == RecordTypeCount) {
+        return offset + 1;
+    }
+
+    return end;
+}
+
+
+template <typename T, typename Table>
+static qint64 AppendRecord(DWORD offset, const T &record, RecordConfidence confidence,
+                           qint64 end, const CarveOptions &options, RecordType type,
+                           Table *table, CarvedRecords *records)
+{
+    if (confidence == WeakRecord) {
+        records->weakRecords.append(offset);
+        ++records->counters.weak[type];
+        if (options.includeWeak) {
+            table->append(offset, record);
+        }
+        return offset + 1;
+    }
+
+    table->append(offset, record);
+    if (confidence == StrongRecord && !options.rescanInterior) {
+        return end;
+    }
+
+    return offset + 1;
+}
+
+
+qint64 ReadRecordAt(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                    DWORD offset, const CarveOptions &options,
+                    CarvedRecords *records)
+{
+    if (lastDataAddr - firstDataAddr < offset + Q_INT64_C(4)) {
+        return offset + 1;
+    }
+
+    const BYTE *data = firstDataAddr + offset;
+    const RecordType type = RecordTypeOf(ReadSignature(data));
+    if (type == RecordTypeCount) {
+        return offset + 1;
+    }
+
+    ++records->counters.hits[type];
+    try {
+        switch (type) {
+        case ContactRecord: {
+            const DBContact contact = ReadDBContact(data, lastDataAddr);
+            return AppendRecord(offset, contact,
+                                ValidateDBContact(firstDataAddr, lastDataAddr, contact,
+                                                  options.checkLinks),
+                                VerifiedRecordEnd(firstDataAddr, lastDataAddr, offset,
+                                                  offset + static_cast<qint64>(DBCONTACT_RECORD_SIZE)),
+                                options, type, &records->contacts, records);
+        }
+        case EventRecord: {
+            const DBEvent event = ReadDBEvent(firstDataAddr, data, lastDataAddr);
+            const RecordConfidence confidence = ValidateDBEvent(firstDataAddr, lastDataAddr,
+                                                                event, options.checkLinks);
+            const qint64 end = VerifiedRecordEnd(firstDataAddr, lastDataAddr, offset,
+                                                 static_cast<qint64>(event.blob.offset)
+                                                 + event.blob.size);
+            // the rejected event isn't stored, but the scan jumps over it
+            // as over the stored one, so the scan doesn't depend on the
+            // filter
+            if ((confidence != WeakRecord || options.includeWeak)
+                    && !AcceptEvent(options.filter, firstDataAddr, lastDataAddr, event)) {
+                ++records->counters.filtered[type];
+                return (confidence == StrongRecord && !options.rescanInterior) ? end : offset + 1;
+            }
+            return AppendRecord(offset, event, confidence, end,
+                                options, type, &records->events, records);
+        }
+        case ModuleNameRecord: {
+            const DBModuleName moduleName = ReadDBModuleName(firstDataAddr, data, lastDataAddr);
+            return AppendRecord(offset, moduleName,
+                                ValidateDBModuleName(firstDataAddr, lastDataAddr, moduleName,
+                                                     options.checkLinks),
+                                VerifiedRecordEnd(firstDataAddr, lastDataAddr, offset,
+                                                  static_cast<qint64>(moduleName.name.offset)
+                                                  + moduleName.name.size),
+                                options, type, &records->moduleNames, records);
+        }
+        default: {
+            const DBContactSettings settings = ReadDBContactSettings(firstDataAddr, data, lastDataAddr);
+            return AppendRecord(offset, settings,
+                                ValidateDBContactSettings(firstDataAddr, lastDataAddr, settings,
+                                                          options.checkLinks),
+                                VerifiedRecordEnd(firstDataAddr, lastDataAddr, offset,
+                                                  static_cast<qint64>(settings.blob.offset)
+                                                  + settings.blob.size),
+                                options, type, &records->contactSettings, records);
+        }
+        }
+    }
+    catch (...) {
+        ++records->counters.failures[type];
+    }
+
+    return offset + 1;
+}
+
+
+// The chunk was scanned from its begin, but the single thread would
+// continue from the end of the strong record of the previous chunk. The
+// chunk is rescanned from there until the scan lands on the signature
+// which the chunk examined too: the rest of the chunk is the same. The
+// chunk keeps only the signatures of its beginning, so the chunk which
+// doesn't meet the rescan there is rescanned whole
+static void ResyncChunk(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                        qint64 from, qint64 to, const CarveOptions &options,
+                        CarvedRecords *chunk)
+{
+    const qint64 dataSize = lastDataAddr - firstDataAddr;
+    const qint64 scanSize = qMin(to + 3, dataSize);
+
+    CarvedRecords rescanned;
+    qint64 next = from;
+    qint64 sync = to;
+    qint64 pos = (next < scanSize) ? FindRecordSignature(firstDataAddr, next, scanSize) : scanSize;
+    while (pos < to && pos < scanSize) {
+        if (std::binary_search(chunk->signatures.constBegin(), chunk->signatures.constEnd(),
+                               static_cast<DWORD>(pos))) {
+            sync = pos;
+            break;
+        }
+
+        rescanned.signatures.append(pos);
+        next = ReadRecordAt(firstDataAddr, lastDataAddr, pos, options, &rescanned);
+        pos = (next < scanSize) ? FindRecordSignature(firstDataAddr, next, scanSize) : scanSize;
+    }
+    if (sync == to) {
+        rescanned.scanEnd = qMax(next, to);
+        *chunk = rescanned;
+        return;
+    }
+    rescanned.scanEnd = chunk->scanEnd;
+
+    // the counters of the dropped part of the chunk are recounted by
+    // reading its signatures again, the part is short
+    CarvedRecords dropped;
+    int signatureCount = 0;
+    while (signatureCount < chunk->signatures.count()
+           && chunk->signatures.at(signatureCount) < sync) {
+        ReadRecordAt(firstDataAddr, lastDataAddr, chunk->signatures.at(signatureCount),
+                     options, &dropped);
+        ++signatureCount;
+    }
+    chunk->signatures.remove(0, signatureCount);
+
+    chunk->contacts.removeBefore(sync);
+    chunk->events.removeBefore(sync);
+    chunk->moduleNames.removeBefore(sync);
+    chunk->contactSettings.removeBefore(sync);
+
+    int weakCount = 0;
+    while (weakCount < chunk->weakRecords.count() && chunk->weakRecords.at(weakCount) < sync) {
+        ++weakCount;
+    }
+    chunk->weakRecords.remove(0, weakCount);
+
+    for (int i = 0; i < RecordTypeCount; ++i) {
+        chunk->counters.hits[i] -= dropped.counters.hits[i];
+        chunk->counters.failures[i] -= dropped.counters.failures[i];
+        chunk->counters.weak[i] -= dropped.counters.weak[i];
+        chunk->counters.filtered[i] -= dropped.counters.filtered[i];
+    }
+
+    MergeRecords(*chunk, &rescanned);
+    *chunk = rescanned;
+}
+
+
+void CarveRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                  const QVector<ScanRange> &ranges, int threadCount,
+                  const CarveOptions &options, CarvedRecords *records)
+{
+    qint64 totalSize = 0;
+    for (int i = 0; i < ranges.count(); ++i) {
+        totalSize += ranges[i].to - ranges[i].from;
+    }
+    ProgressAddTotalBytes(totalSize);
+
+    // the ranges are split into the chunks of the same size, one chunk
+    // per thread, the small ranges are not split
+    const qint64 chunkSize = qMax(MIN_CHUNK_SIZE, totalSize / qMax(1, threadCount));
+    QVector<ScanRange> chunkRanges;
+    QVector<bool> continued;    // the chunk continues the previous one
+    for (int i = 0; i < ranges.count(); ++i) {
+        for (qint64 from = ranges[i].from; from < ranges[i].to; from += chunkSize) {
+            ScanRange chunk;
+            chunk.from = from;
+            chunk.to = qMin(from + chunkSize, ranges[i].to);
+            chunkRanges.append(chunk);
+            continued.append(from != ranges[i].from);
+        }
+    }
+
+    // each chunk has its own table, so the workers don't share anything
+    // except the read-only image
+    QVector<CarvedRecords> chunks(chunkRanges.count());
+    if (threadCount <= 1 || chunkRanges.count() <= 1) {
+        for (int i = 0; i < chunkRanges.count(); ++i) {
+            const qint64 from = (i > 0 && continued[i])
+                    ? qMax(chunkRanges[i].from, chunks[i - 1].scanEnd)
+                    : chunkRanges[i].from;
+            CarveRecords(firstDataAddr, lastDataAddr, from, chunkRanges[i].to,
+                         options, &chunks[i]);
+        }
+    }
+    else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        for (int i = 0; i < chunkRanges.count(); ++i) {
+            pool.start(new CarveTask(firstDataAddr, lastDataAddr,
+                                     chunkRanges[i].from, chunkRanges[i].to,
+                                     options, &chunks[i]));
+        }
+        pool.waitForDone();
+
+        for (int i = 1; i < chunks.count(); ++i) {
+            if (continued[i] && chunks[i - 1].scanEnd > chunkRanges[i].from) {
+                ResyncChunk(firstDataAddr, lastDataAddr, chunks[i - 1].scanEnd,
+                            chunkRanges[i].to, options, &chunks[i]);
+            }
+        }
+    }
+
+    // the chunks are ordered by the offset, so the records are appended
+    // in the same order as by the single thread. The single chunk is
+    // shared, the others are copied into the reserved tables, and each
+    // chunk is released once it is appended
+    if (chunks.count() > 1) {
+        int contactCount = records->contacts.count();
+        int eventCount = records->events.count();
+        int moduleNameCount = records->moduleNames.count();
+        int settingsCount = records->contactSettings.count();
+        for (int i = 0; i < chunks.count(); ++i) {
+            contactCount += chunks[i].contacts.count();
+            eventCount += chunks[i].events.count();
+            moduleNameCount += chunks[i].moduleNames.count();
+            settingsCount += chunks[i].contactSettings.count();
+        }
+        records->contacts.reserve(contactCount);
+        records->events.reserve(eventCount);
+        records->moduleNames.reserve(moduleNameCount);
+        records->contactSettings.reserve(settingsCount);
+    }
+    for (int i = 0; i < chunks.count(); ++i) {
+        records->contacts.merge(chunks[i].contacts);
+        records->events.merge(chunks[i].events);
+        records->moduleNames.merge(chunks[i].moduleNames);
+        records->contactSettings.merge(chunks[i].contactSettings);
+        if (options.keepSignatures) {
+            records->signatures += chunks[i].signatures;
+        }
+        records->weakRecords += chunks[i].weakRecords;
+        records->counters.add(chunks[i].counters);
+        records->scanEnd = chunks[i].scanEnd;
+        chunks[i] = CarvedRecords();
+    }
+}
+
+
+void MergeRecords(const CarvedRecords &from, CarvedRecords *to)
+{
+    to->contacts.merge(from.contacts);
+    to->events.merge(from.events);
+    to->moduleNames.merge(from.moduleNames);
+    to->contactSettings.merge(from.contactSettings);
+    MergeOffsets(from.signatures, &to->signatures);
+    MergeOffsets(from.weakRecords, &to->weakRecords);
+    to->counters.add(from.counters);
+}
+
+
+void StoreRecords(const BYTE *firstDataAddr, CarvedRecords *carved,
+                  DBRecords *records)
+{
+    records->contacts.merge(carved->contacts);
+    records->events.merge(carved->events);
+    records->moduleNames.merge(carved->moduleNames);
+    records->contactSettings.merge(carved->contactSettings);
+    records->weakRecords += carved->weakRecords;
+    records->counters.add(carved->counters);
+
+    // the empty tables share the carved ones, which are released before
+    // the ids are set, so the columns aren't detached
+    carved->contacts = RecordTable<DBContact>();
+    carved->events = EventTable();
+    carved->moduleNames = RecordTable<DBModuleName>();
+    carved->contactSettings = RecordTable<DBContactSettings>();
+
+    records->moduleNameTable.build(firstDataAddr, records->moduleNames);
+
+    EventTable &events = records->events;
+    for (int i = 0; i < events.count(); ++i) {
+        events.setModuleId(i, records->moduleNameTable.idByOffset(events.ofsModuleName(i)));
+    }
+
+    RecordTable<DBContactSettings> &settings = records->contactSettings;
+    for (int i = 0; i < settings.count(); ++i) {
+        settings[i].moduleId = records->moduleNameTable.idByOffset(settings.at(i).ofsModuleName);
+    }
+}
+
+
+void CarveRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                  int threadCount, const CarveOptions &options,
+                  DBRecords *records)
+{
+    ScanRange range;
+    range.from = 0;
+    range.to = lastDataAddr - firstDataAddr;
+
+    CarvedRecords carved;
+    CarveRecords(firstDataAddr, lastDataAddr, QVector<ScanRange>() << range,
+                 threadCount, options, &carved);
+    StoreRecords(firstDataAddr, &carved, records);
+}
@@ -0,0 +1,153 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECORDCARVER_H
+#define RECORDCARVER_H
+
+
+#include "mirandadb.h"
+#include "modulenametable.h"
+#include "recordfilter.h"
+#include "recordtable.h"
+#include <QVector>
+
+
+enum RecordType {
+    ContactRecord,
+    EventRecord,
+    ModuleNameRecord,
+    ContactSettingsRecord,
+    RecordTypeCount
+};
+
+
+// The number of the found signatures, of the records which failed to
+// parse, of the weak records and of the records rejected by the filter
+// for each type, the failed and the weak records are the false positives
+// of the scanner
+struct CarveCounters {
+    CarveCounters();
+    void add(const CarveCounters &other);
+
+    qint64 hits[RecordTypeCount];
+    qint64 failures[RecordTypeCount];
+    qint64 weak[RecordTypeCount];
+    qint64 filtered[RecordTypeCount];
+};
+
+
+// The records found by the brutforce algorithm sorted by the offset of
+// the record inside the database image
+struct DBRecords {
+    RecordTable<DBContact> contacts;
+    EventTable events;
+    RecordTable<DBModuleName> moduleNames;
+    RecordTable<DBContactSettings> contactSettings;
+    ModuleNameTable moduleNameTable;
+    CarveCounters counters;
+    // the offsets of the weak records, see recordvalidator.h. They are
+    // in the tables too only if CarveOptions::includeWeak is set
+    QVector<DWORD> weakRecords;
+};
+
+
+// The records found inside the one chunk of the database image, sorted
+// by the offset. The records are appended right to the tables, so the
+// chunks are concatenated and stored without the copy per record
+struct CarvedRecords {
+    RecordTable<DBContact> contacts;
+    EventTable events;
+    RecordTable<DBModuleName> moduleNames;
+    RecordTable<DBContactSettings> contactSettings;
+    // the offsets of the examined signatures, including the ones which
+    // aren't valid records; the signatures inside the strong records are
+    // skipped. They are kept only if CarveOptions::keepSignatures is set
+    QVector<DWORD> signatures;
+    QVector<DWORD> weakRecords;
+    CarveCounters counters;
+    // the scan continues from here, it's past the end of the chunk if the
+    // last strong record lies across the end
+    qint64 scanEnd;
+
+    CarvedRecords() : scanEnd(0) {}
+};
+
+
+// The range [from, to) of the database image
+struct ScanRange {
+    qint64 from;
+    qint64 to;
+};
+
+
+// The way of the carving
+struct CarveOptions {
+    CarveOptions()
+        : rescanInterior(false), checkLinks(true), includeWeak(false),
+          keepSignatures(false), filter(0) {}
+
+    bool rescanInterior;    // scan the interior of the strong records too
+    bool checkLinks;        // the image is the database, so the links of
+                            // the records are validated, see recordvalidator.h
+    bool includeWeak;       // store the weak records too, the scan doesn't
+                            // jump over them anyway
+    bool keepSignatures;    // keep the offsets of the examined signatures,
+                            // the scan index is built of them
+    const RecordFilter *filter; // the events to store, may be null
+};
+
+
+// Carves the records whose signature begins inside [from, to). The
+// record itself may lie past the end of the chunk, it is read up to
+// the lastDataAddr. The scan jumps over the strong records unless
+// rescanInterior is set. The events rejected by the filter aren't
+// stored, the scan jumps over them as over the stored ones
+void CarveRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                  qint64 from, qint64 to, const CarveOptions &options,
+                  CarvedRecords *records);
+
+// Reads the record which signature begins at the offset, the weak record
+// goes to the weakRecords (and to its table if includeWeak is set).
+// Returns the offset where the scan continues: the end of the strong
+// record unless rescanInterior is set, otherwise the next byte
+qint64 ReadRecordAt(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                    DWORD offset, const CarveOptions &options,
+                    CarvedRecords *records);
+
+// Carves the sorted non-overlapping ranges. If threadCount is greater
+// than one the ranges are split into chunks which are carved in
+// parallel, the chunks are appended to the records in the order of the
+// offsets and released one by one. The chunk which begins inside the strong record of the
+// previous one is rescanned from its end, so the result is the same as
+// for the single thread
+void CarveRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                  const QVector<ScanRange> &ranges, int threadCount,
+                  const CarveOptions &options, CarvedRecords *records);
+
+// Merges the records sorted by the offset, the result is sorted too
+void MergeRecords(const CarvedRecords &from, CarvedRecords *to);
+
+// Moves the records sorted by the offset into the tables, the tables of
+// the carved records are left empty. The module names are interned, the
+// events and the settings get the ids of their modules
+void StoreRecords(const BYTE *firstDataAddr, CarvedRecords *carved,
+                  DBRecords *records);
+
+// Carves the whole database image, see above
+void CarveRecords(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                  int threadCount, const CarveOptions &options,
+                  DBRecords *records);
+
+
+#endif // RECORDCARVER_H
@@ -0,0 +1,143 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recorddedup.h"
+#include "chainwalker.h"
+#include "fasthash.h"
+#include <cstring>
+
+
+// the module of the event: the interned id, so the stale copy of the
+// event which points to the stale copy of DBModuleName matches its live
+// twin. The unknown modules are told apart by ofsModuleName
+static quint64 EventModule(const EventTable &events, int i)
+{
+    const WORD moduleId = events.moduleId(i);
+    if (moduleId != UNKNOWN_MODULE_ID) {
+        return moduleId;
+    }
+
+    return Q_UINT64_C(0x100000000) | events.ofsModuleName(i);
+}
+
+
+static quint64 EventFingerprint(const BYTE *firstDataAddr, const EventTable &events, int i)
+{
+    const quint64 fields[] = {
+        EventModule(events, i), events.timestamp(i), events.flags(i), events.eventType(i)
+    };
+    const DBView blob = events.blob(i);
+
+    return FastHash64(ViewData(firstDataAddr, blob), blob.size,
+                      FastHash64(fields, sizeof(fields)));
+}
+
+
+static bool IsSameEvent(const BYTE *firstDataAddr, const EventTable &events, int a, int b)
+{
+    const DBView blobA = events.blob(a);
+    const DBView blobB = events.blob(b);
+
+    return EventModule(events, a) == EventModule(events, b)
+            && events.timestamp(a) == events.timestamp(b)
+            && events.flags(a) == events.flags(b)
+            && events.eventType(a) == events.eventType(b)
+            && blobA.size == blobB.size
+            && !memcmp(ViewData(firstDataAddr, blobA), ViewData(firstDataAddr, blobB), blobA.size);
+}
+
+
+// The open-addressing set of the events with the linear probing by the
+// fingerprints, the slot has the index of the first inserted copy of the
+// event. The fingerprint 0 marks the empty slot, so it's replaced by 1
+class EventSet
+{
+public:
+    EventSet(const BYTE *firstDataAddr, const EventTable &events)
+        : m_firstDataAddr(firstDataAddr), m_events(events)
+    {
+        int capacity = 16;
+        while (capacity < events.count() * 2) {
+            capacity *= 2;
+        }
+        m_fingerprints.fill(0, capacity);
+        m_indexes.resize(capacity);
+        m_mask = capacity - 1;
+    }
+
+    // returns the index of the same event or inserts the event and
+    // returns false. The different events with the same fingerprint
+    // are probed past, each of them is inserted
+    bool findOrInsert(int index, int *found)
+    {
+        quint64 fingerprint = EventFingerprint(m_firstDataAddr, m_events, index);
+        if (fingerprint == 0) {
+            fingerprint = 1;
+        }
+
+        for (int i = fingerprint & m_mask; ; i = (i + 1) & m_mask) {
+            if (m_fingerprints[i] == 0) {
+                m_fingerprints[i] = fingerprint;
+                m_indexes[i] = index;
+                return false;
+            }
+            if (m_fingerprints[i] == fingerprint
+                    && IsSameEvent(m_firstDataAddr, m_events, index, m_indexes[i])) {
+                *found = m_indexes[i];
+                return true;
+            }
+        }
+    }
+
+private:
+    const BYTE *m_firstDataAddr;
+    const EventTable &m_events;
+    QVector<quint64> m_fingerprints;
+    QVector<int> m_indexes;
+    int m_mask;
+};
+
+
+int DeduplicateEvents(const BYTE *firstDataAddr, DBRecords *records)
+{
+    const EventTable &events = records->events;
+    const QVector<DWORD> owners = EventOwners(*records);
+
+    // the reachable events first, then the newest ones. The reachable
+    // event is never removed, the unreachable one is removed if the
+    // preferred copy is the same event
+    EventSet set(firstDataAddr, events);
+    QVector<bool> duplicates(events.count(), false);
+    int duplicateCount = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        const bool reachable = (pass == 0);
+        for (int i = events.count() - 1; i >= 0; --i) {
+            if ((owners.at(i) != 0) != reachable) {
+                continue;
+            }
+
+            int found;
+            if (set.findOrInsert(i, &found) && !reachable) {
+                duplicates[i] = true;
+                ++duplicateCount;
+            }
+        }
+    }
+
+    if (duplicateCount) {
+        records->events.remove(duplicates);
+    }
+
+    return duplicateCount;
+}
@@ -0,0 +1,33 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECORDDEDUP_H
+#define RECORDDEDUP_H
+
+
+#include "recordcarver.h"
+
+
+// Removes the stale copies of the events. Miranda moves the record when
+// it grows and the old copy stays in the slack space, the carver finds
+// both. The events are fingerprinted by the module id, the timestamp, the
+// flags, the type and the blob; of the equal events the copies which
+// are reachable by the event chain of a contact are kept (the same
+// message sent to several contacts is several live events), if none is
+// reachable the newest one (with the greatest offset) is kept. Returns
+// the number of the removed events
+int DeduplicateEvents(const BYTE *firstDataAddr, DBRecords *records);
+
+
+#endif // RECORDDEDUP_H
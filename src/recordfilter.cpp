@@ -0,0 +1,94 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recordfilter.h"
+#include "chainwalker.h"
+#include <cstring>
+
+
+// compares the name of the module record at the offset in place, the
+// name may be terminated by zero
+static bool IsModuleNameAt(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                           DWORD offset, const QByteArray &name)
+{
+    const qint64 dataSize = lastDataAddr - firstDataAddr;
+    if (offset + Q_INT64_C(9) > dataSize
+            || ReadSignature(firstDataAddr + offset) != DBMODULENAME_SIGNATURE) {
+        return false;
+    }
+
+    const BYTE *data = firstDataAddr + offset + 9;
+    const int cbName = qMin<qint64>(firstDataAddr[offset + 8], dataSize - offset - 9);
+    const int size = qstrnlen((const char *)data, cbName);
+
+    return size == name.size() && !memcmp(data, name.constData(), size);
+}
+
+
+bool AcceptEvent(const RecordFilter *filter, const BYTE *firstDataAddr,
+                 const BYTE *lastDataAddr, const DBEvent &event)
+{
+    if (!filter) {
+        return true;
+    }
+    if (event.timestamp < filter->since
+            || (filter->until && event.timestamp >= filter->until)) {
+        return false;
+    }
+    if (filter->moduleNames.isEmpty()) {
+        return true;
+    }
+
+    for (int i = 0; i < filter->moduleNames.count(); ++i) {
+        if (IsModuleNameAt(firstDataAddr, lastDataAddr, event.ofsModuleName,
+                           filter->moduleNames.at(i))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+bool AcceptContact(const RecordFilter *filter, DWORD contactId)
+{
+    return !filter || filter->contactIds.isEmpty() || filter->contactIds.contains(contactId);
+}
+
+
+int FilterContacts(const RecordFilter &filter, DWORD userContactId,
+                   DBRecords *records)
+{
+    if (filter.contactIds.isEmpty()) {
+        return 0;
+    }
+
+    QVector<bool> contactRemoved(records->contacts.count(), false);
+    for (int i = 0; i < records->contacts.count(); ++i) {
+        const DWORD id = records->contacts.offset(i);
+        contactRemoved[i] = (id != userContactId && !filter.contactIds.contains(id));
+    }
+    records->counters.filtered[ContactRecord] += records->contacts.remove(contactRemoved);
+
+    // the user contact is kept only for its settings
+    const QVector<DWORD> owners = EventOwners(*records);
+    QVector<bool> eventRemoved(owners.count(), false);
+    for (int i = 0; i < owners.count(); ++i) {
+        eventRemoved[i] = !owners.at(i) || !filter.contactIds.contains(owners.at(i));
+    }
+    const int removed = records->events.remove(eventRemoved);
+    records->counters.filtered[EventRecord] += removed;
+
+    return removed;
+}
@@ -0,0 +1,54 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECORDFILTER_H
+#define RECORDFILTER_H
+
+
+#include "mirandadb.h"
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+struct DBRecords;
+
+
+// The selection of the recovered events. The time range and the module
+// names are checked by the scanners right after the header of the event
+// is read, the rejected events aren't stored. The contacts are the ids
+// of the output (the offsets of the records): the walker doesn't keep
+// the chains of the other contacts, the carved records are filtered by
+// FilterContacts()
+struct RecordFilter {
+    RecordFilter() : since(0), until(0) {}
+
+    DWORD since;    // the first accepted timestamp, 0 - no bound
+    DWORD until;    // the first rejected timestamp, 0 - no bound
+    QList<QByteArray> moduleNames;
+    QSet<DWORD> contactIds;
+};
+
+
+// the null filter accepts everything
+bool AcceptEvent(const RecordFilter *filter, const BYTE *firstDataAddr,
+                 const BYTE *lastDataAddr, const DBEvent &event);
+bool AcceptContact(const RecordFilter *filter, DWORD contactId);
+
+// Removes the contacts which aren't selected and the events which
+// aren't in the chains of the selected contacts, the user contact is
+// kept for the accounts. Returns the number of the removed events
+int FilterContacts(const RecordFilter &filter, DWORD userContactId,
+                   DBRecords *records);
+
+
+#endif // RECORDFILTER_H
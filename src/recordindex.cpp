@@ -0,0 +1,653 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recordindex.h"
+#include "eventtext.h"
+#include "extractionschema.h"
+#include "fasthash.h"
+#include "jsonoutput.h"
+#include "mirandadbimage.h"
+#include "progress.h"
+#include "recoveryvisitor.h"
+#include <QPair>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QSet>
+#include <QTextCodec>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+
+// the format of the index file (all numbers are little-endian):
+//   magic[8], databaseSize (low, high), databaseHash (low, high),
+//   moduleCount, contactCount, eventCount
+//   for each module: size, the utf-8 name padded to 4 bytes
+//   contactCount * contact offset
+//   eventCount * (offset, ofsPrev, ofsNext, timestamp, contactId, flags,
+//                 cbBlob, eventType | moduleId << 16), sorted by offset
+//   eventCount * event number, sorted by contact, timestamp, offset
+//   eventCount * event number, sorted by timestamp, offset
+static const char RECORDINDEX_MAGIC[] = "MDBREC01";
+static const int RECORDINDEX_MAGIC_SIZE = 8;
+static const int RECORDINDEX_EVENT_FIELDS = 8;
+
+// the database is identified by its size and by the hash of its begin,
+// the header is changed by each write of miranda
+static const qint64 RECORDINDEX_HASHED_SIZE = 64 * 1024;
+
+// the fields of the event in the index
+enum RecordIndexField {
+    OffsetField,
+    PrevField,
+    NextField,
+    TimestampField,
+    ContactField,
+    FlagsField,
+    BlobSizeField,
+    TypeField
+};
+
+
+static bool ReadDatabaseIdentity(const QString &fileName, qint64 *size, quint64 *hash)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray begin = file.read(RECORDINDEX_HASHED_SIZE);
+    *size = file.size();
+    *hash = FastHash64(begin.constData(), begin.size());
+
+    return true;
+}
+
+
+RecordIndex::RecordIndex()
+    : m_map(0), m_databaseSize(0), m_databaseHash(0), m_contactCount(0),
+      m_eventCount(0), m_contacts(0), m_events(0), m_byContact(0), m_byTime(0)
+{
+}
+
+RecordIndex::~RecordIndex()
+{
+    close();
+}
+
+bool RecordIndex::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    if (size > 0) {
+        m_map = m_file.map(0, size);
+    }
+    if (!m_map) {
+        m_errorString = "can't map the index";
+        close();
+        return false;
+    }
+
+    const BYTE *data = m_map;
+    const BYTE *lastAddr = m_map + size;
+    try {
+        CheckBounds(data, lastAddr, RECORDINDEX_MAGIC_SIZE + 7 * sizeof(DWORD));
+        if (memcmp(data, RECORDINDEX_MAGIC, RECORDINDEX_MAGIC_SIZE)) {
+            throw QString("invalid data format");
+        }
+        data += RECORDINDEX_MAGIC_SIZE;
+
+        m_databaseSize = ReadQWord(data);
+        m_databaseHash = ReadQWord(data);
+        const DWORD moduleCount = ReadDWord(data);
+        const DWORD contactCount = ReadDWord(data);
+        const DWORD eventCount = ReadDWord(data);
+        if (moduleCount == 0 || contactCount > INT_MAX || eventCount > INT_MAX) {
+            throw QString("invalid data format");
+        }
+
+        for (DWORD i = 0; i < moduleCount; ++i) {
+            CheckBounds(data, lastAddr, sizeof(DWORD));
+            const DWORD nameSize = ReadDWord(data);
+            const DWORD paddedSize = (nameSize + 3) & ~3u;
+            CheckBounds(data, lastAddr, paddedSize);
+            m_moduleNames.append(QString::fromUtf8((const char *)data, nameSize));
+            data += paddedSize;
+        }
+
+        // the sections of the records have the fixed size
+        const quint64 recordsSize = contactCount * Q_UINT64_C(4)
+                + eventCount * Q_UINT64_C(4) * (RECORDINDEX_EVENT_FIELDS + 2);
+        if (recordsSize != static_cast<quint64>(lastAddr - data)) {
+            throw QString("invalid data format");
+        }
+        m_contactCount = contactCount;
+        m_eventCount = eventCount;
+        m_contacts = data;
+        m_events = m_contacts + contactCount * sizeof(DWORD);
+        m_byContact = m_events + eventCount * sizeof(DWORD) * RECORDINDEX_EVENT_FIELDS;
+        m_byTime = m_byContact + eventCount * sizeof(DWORD);
+        if (!isConsistent()) {
+            throw QString("invalid data format");
+        }
+    }
+    catch (...) {
+        m_errorString = "it's not a record index";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void RecordIndex::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = 0;
+    }
+    m_file.close();
+    m_databaseSize = 0;
+    m_databaseHash = 0;
+    m_moduleNames.clear();
+    m_contactCount = 0;
+    m_eventCount = 0;
+    m_contacts = 0;
+    m_events = 0;
+    m_byContact = 0;
+    m_byTime = 0;
+}
+
+DWORD RecordIndex::contactId(int i) const
+{
+    return DWordAt(m_contacts, i);
+}
+
+RecordIndexEvent RecordIndex::event(int i) const
+{
+    const BYTE *data = m_events + static_cast<qint64>(i) * RECORDINDEX_EVENT_FIELDS * sizeof(DWORD);
+
+    RecordIndexEvent event;
+    event.offset = ReadDWord(data);
+    event.ofsPrev = ReadDWord(data);
+    event.ofsNext = ReadDWord(data);
+    event.timestamp = ReadDWord(data);
+    event.contactId = ReadDWord(data);
+    event.flags = ReadDWord(data);
+    event.cbBlob = ReadDWord(data);
+    event.eventType = ReadWord(data);
+    event.moduleId = ReadWord(data);
+    if (event.moduleId >= m_moduleNames.count()) {
+        event.moduleId = UNKNOWN_MODULE_ID;
+    }
+
+    return event;
+}
+
+int RecordIndex::indexOfEvent(DWORD offset) const
+{
+    int from = 0;
+    int count = m_eventCount;
+    while (count > 0) {
+        const int step = count / 2;
+        if (eventField(from + step, OffsetField) < offset) {
+            from += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    if (from == m_eventCount || eventField(from, OffsetField) != offset) {
+        return -1;
+    }
+
+    return from;
+}
+
+QVector<int> RecordIndex::contactEvents(DWORD contactId, DWORD since, DWORD until) const
+{
+    const quint64 contactKey = static_cast<quint64>(contactId) << 32;
+    const int from = bound(m_byContact, true, contactKey | since, false);
+    const int to = until ? bound(m_byContact, true, contactKey | until, false)
+                         : bound(m_byContact, true, contactKey | 0xFFFFFFFFu, true);
+
+    QVector<int> events;
+    events.reserve(qMax(0, to - from));
+    for (int i = from; i < to; ++i) {
+        events.append(DWordAt(m_byContact, i));
+    }
+
+    return events;
+}
+
+QVector<int> RecordIndex::timeRangeEvents(DWORD since, DWORD until) const
+{
+    const int from = bound(m_byTime, false, since, false);
+    const int to = until ? bound(m_byTime, false, until, false) : m_eventCount;
+
+    QVector<int> events;
+    events.reserve(qMax(0, to - from));
+    for (int i = from; i < to; ++i) {
+        events.append(DWordAt(m_byTime, i));
+    }
+
+    return events;
+}
+
+DWORD RecordIndex::eventField(int i, int field) const
+{
+    return DWordAt(m_events, static_cast<qint64>(i) * RECORDINDEX_EVENT_FIELDS + field);
+}
+
+quint64 RecordIndex::eventKey(int i, bool byContact) const
+{
+    quint64 key = eventField(i, TimestampField);
+    if (byContact) {
+        key |= static_cast<quint64>(eventField(i, ContactField)) << 32;
+    }
+
+    return key;
+}
+
+bool RecordIndex::isConsistent() const
+{
+    for (int i = 1; i < m_eventCount; ++i) {
+        if (eventField(i - 1, OffsetField) >= eventField(i, OffsetField)) {
+            return false;
+        }
+    }
+
+    const uchar *const orders[] = { m_byContact, m_byTime };
+    for (int order = 0; order < 2; ++order) {
+        const bool byContact = (order == 0);
+        quint64 previousKey = 0;
+        for (int i = 0; i < m_eventCount; ++i) {
+            const DWORD event = DWordAt(orders[order], i);
+            if (event >= static_cast<DWORD>(m_eventCount)) {
+                return false;
+            }
+
+            const quint64 key = eventKey(event, byContact);
+            if (key < previousKey) {
+                return false;
+            }
+            previousKey = key;
+        }
+    }
+
+    return true;
+}
+
+int RecordIndex::bound(const uchar *order, bool byContact, quint64 key, bool upper) const
+{
+    int from = 0;
+    int count = m_eventCount;
+    while (count > 0) {
+        const int step = count / 2;
+        const quint64 orderKey = eventKey(DWordAt(order, from + step), byContact);
+        if (orderKey < key || (upper && orderKey == key)) {
+            from += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    return from;
+}
+
+
+// Keeps the validated contacts and events, the index is written when
+// all records are handed out
+class RecordIndexVisitor : public RecoveryVisitor
+{
+public:
+    RecordIndexVisitor(const QString &fileName, qint64 databaseSize, quint64 databaseHash)
+        : m_fileName(fileName), m_databaseSize(databaseSize), m_databaseHash(databaseHash)
+    {
+    }
+
+    // the settings aren't indexed, the ones of the default schema are
+    // the least to decode
+    const ExtractionSchema *schema() const
+    {
+        return &m_schema;
+    }
+
+    bool eventOwnersRequired() const
+    {
+        return true;
+    }
+
+    void onModule(WORD /* id */, const QString &name)
+    {
+        m_moduleNames.append(name);
+    }
+
+    void onContact(DWORD id, const DBContact & /* contact */)
+    {
+        m_contacts.append(id);
+    }
+
+    void onEvent(const EventView &view)
+    {
+        const DBEvent &dbEvent = view.event();
+
+        RecordIndexEvent event;
+        event.offset = view.id();
+        event.ofsPrev = dbEvent.ofsPrev;
+        event.ofsNext = dbEvent.ofsNext;
+        event.timestamp = dbEvent.timestamp;
+        event.contactId = view.contactId();
+        event.flags = dbEvent.flags;
+        event.cbBlob = dbEvent.blob.size;
+        event.eventType = dbEvent.eventType;
+        event.moduleId = dbEvent.moduleId;
+        m_events.append(event);
+    }
+
+    bool onEnd()
+    {
+        // the index of the interrupted recovery would miss the records
+        if (IsStopRequested()) {
+            std::cerr << "interrupted, the index isn't written: " << m_fileName.toStdString() << std::endl;
+            return false;
+        }
+
+        QSaveFile file(m_fileName);
+        const QByteArray data = serialize();
+        if (!file.open(QIODevice::WriteOnly)
+                || file.write(data) != data.size()
+                || !file.commit()) {
+            std::cerr << "can't write file: " << m_fileName.toStdString() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+private:
+    QByteArray serialize() const
+    {
+        QByteArray data;
+        data.reserve(RECORDINDEX_MAGIC_SIZE + 7 * sizeof(DWORD)
+                     + (m_contacts.count() + m_events.count() * (RECORDINDEX_EVENT_FIELDS + 2))
+                     * sizeof(DWORD));
+        data.append(RECORDINDEX_MAGIC, RECORDINDEX_MAGIC_SIZE);
+        WriteQWord(&data, m_databaseSize);
+        WriteQWord(&data, m_databaseHash);
+        WriteDWord(&data, m_moduleNames.count());
+        WriteDWord(&data, m_contacts.count());
+        WriteDWord(&data, m_events.count());
+
+        for (int i = 0; i < m_moduleNames.count(); ++i) {
+            const QByteArray name = m_moduleNames.at(i).toUtf8();
+            WriteDWord(&data, name.size());
+            data.append(name);
+            data.append(QByteArray((4 - name.size() % 4) % 4, '\0'));
+        }
+
+        for (int i = 0; i < m_contacts.count(); ++i) {
+            WriteDWord(&data, m_contacts.at(i));
+        }
+
+        // the events are handed out in the order of the offsets, so the
+        // number of the event breaks the ties of both orders
+        QVector<QPair<quint64, int> > byContact(m_events.count());
+        QVector<QPair<quint64, int> > byTime(m_events.count());
+        for (int i = 0; i < m_events.count(); ++i) {
+            const RecordIndexEvent &event = m_events.at(i);
+            WriteDWord(&data, event.offset);
+            WriteDWord(&data, event.ofsPrev);
+            WriteDWord(&data, event.ofsNext);
+            WriteDWord(&data, event.timestamp);
+            WriteDWord(&data, event.contactId);
+            WriteDWord(&data, event.flags);
+            WriteDWord(&data, event.cbBlob);
+            WriteDWord(&data, event.eventType | (static_cast<DWORD>(event.moduleId) << 16));
+
+            byContact[i] = qMakePair((static_cast<quint64>(event.contactId) << 32) | event.timestamp, i);
+            byTime[i] = qMakePair(static_cast<quint64>(event.timestamp), i);
+        }
+        std::sort(byContact.begin(), byContact.end());
+        std::sort(byTime.begin(), byTime.end());
+
+        for (int i = 0; i < byContact.count(); ++i) {
+            WriteDWord(&data, byContact.at(i).second);
+        }
+        for (int i = 0; i < byTime.count(); ++i) {
+            WriteDWord(&data, byTime.at(i).second);
+        }
+
+        return data;
+    }
+
+    QString m_fileName;
+    qint64 m_databaseSize;
+    quint64 m_databaseHash;
+    ExtractionSchema m_schema;
+    QVector<QString> m_moduleNames;
+    QVector<DWORD> m_contacts;
+    QVector<RecordIndexEvent> m_events;
+};
+
+
+bool BuildRecordIndex(const QString &mirandaDbFile,
+                      const QString &indexFileName,
+                      const Miranda2JsonOptions &options)
+{
+    qint64 databaseSize = 0;
+    quint64 databaseHash = 0;
+    if (!ReadDatabaseIdentity(mirandaDbFile, &databaseSize, &databaseHash)) {
+        std::cerr << "can't open file for read: " << mirandaDbFile.toStdString() << std::endl;
+        return false;
+    }
+
+    // the queries select the records, so the index keeps all of them
+    Miranda2JsonOptions indexOptions = options;
+    indexOptions.filter = RecordFilter();
+    indexOptions.scanIndex = false;
+
+    RecordIndexVisitor visitor(indexFileName, databaseSize, databaseHash);
+    return VisitMirandaDb(mirandaDbFile, indexOptions, &visitor);
+}
+
+
+// the numbers of the selected messages in the order of the offsets
+static QVector<int> SelectEvents(const RecordIndex &index, const RecordQuery &query)
+{
+    const RecordFilter &filter = query.filter;
+
+    // the events are taken from the narrowest order
+    QVector<int> candidates;
+    if (!query.offsets.isEmpty()) {
+        for (int i = 0; i < query.offsets.count(); ++i) {
+            const int event = index.indexOfEvent(query.offsets.at(i));
+            if (event != -1) {
+                candidates.append(event);
+            }
+        }
+    }
+    else if (!filter.contactIds.isEmpty()) {
+        foreach (const DWORD contactId, filter.contactIds) {
+            candidates += index.contactEvents(contactId, filter.since, filter.until);
+        }
+    }
+    else {
+        candidates = index.timeRangeEvents(filter.since, filter.until);
+    }
+
+    QSet<WORD> moduleIds;
+    for (int id = 0; id < index.moduleCount(); ++id) {
+        if (filter.moduleNames.contains(index.moduleName(id).toUtf8())) {
+            moduleIds.insert(id);
+        }
+    }
+
+    QVector<QPair<DWORD, int> > selected;
+    for (int i = 0; i < candidates.count(); ++i) {
+        const RecordIndexEvent event = index.event(candidates.at(i));
+        if (!IsMessageEvent(event.eventType)
+                || event.timestamp < filter.since
+                || (filter.until && event.timestamp >= filter.until)
+                || !AcceptContact(&filter, event.contactId)
+                || (!filter.moduleNames.isEmpty() && !moduleIds.contains(event.moduleId))) {
+            continue;
+        }
+        selected.append(qMakePair(event.timestamp, candidates.at(i)));
+    }
+
+    // the last messages by the time, the same offset may be asked twice
+    std::sort(selected.begin(), selected.end());
+    selected.resize(std::unique(selected.begin(), selected.end()) - selected.begin());
+    if (query.last > 0 && selected.count() > query.last) {
+        selected.remove(0, selected.count() - query.last);
+    }
+
+    QVector<int> events;
+    events.reserve(selected.count());
+    for (int i = 0; i < selected.count(); ++i) {
+        events.append(selected.at(i).second);
+    }
+    std::sort(events.begin(), events.end());
+
+    return events;
+}
+
+
+// Reads the indexed event from the database again: the identity of the
+// database covers only its size and head, so the profile changed in place
+// still matches the index. Returns false if the record at the offset
+// isn't the indexed event any more
+static bool ReadIndexedEvent(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                             const RecordIndexEvent &indexed, DBEvent *event)
+{
+    if (indexed.offset + Q_INT64_C(4) > lastDataAddr - firstDataAddr
+            || ReadSignature(firstDataAddr + indexed.offset) != DBEVENT_SIGNATURE) {
+        return false;
+    }
+
+    try {
+        *event = ReadDBEvent(firstDataAddr, firstDataAddr + indexed.offset, lastDataAddr);
+    }
+    catch (...) {
+        return false;
+    }
+
+    return event->timestamp == indexed.timestamp
+            && event->cbBlob == indexed.cbBlob
+            && event->eventType == indexed.eventType;
+}
+
+
+bool QueryRecordIndex(const QString &indexFileName,
+                      const QString &mirandaDbFile,
+                      const QString &outputFileName,
+                      const RecordQuery &query,
+                      const Miranda2JsonOptions &options)
+{
+    RecordIndex index;
+    if (!index.open(indexFileName)) {
+        std::cerr << "can't read the record index: " << indexFileName.toStdString()
+                  << " (" << index.errorString().toStdString() << ")" << std::endl;
+        return false;
+    }
+
+    qint64 databaseSize = 0;
+    quint64 databaseHash = 0;
+    if (!ReadDatabaseIdentity(mirandaDbFile, &databaseSize, &databaseHash)) {
+        std::cerr << "can't open file for read: " << mirandaDbFile.toStdString() << std::endl;
+        return false;
+    }
+    if (databaseSize != index.databaseSize() || databaseHash != index.databaseHash()) {
+        std::cerr << "the record index was built for the other database: "
+                  << indexFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    // the database is mapped, so only the pages of the selected blobs
+    // are read
+    MirandaDbImage image;
+    if (!image.open(mirandaDbFile, true)) {
+        std::cerr << "can't open file for read: " << mirandaDbFile.toStdString()
+                  << " (" << image.errorString().toStdString() << ")" << std::endl;
+        return false;
+    }
+    const BYTE *const firstDataAddr = image.data();
+    const BYTE *const lastDataAddr = firstDataAddr + image.size();
+
+    const QVector<int> events = SelectEvents(index, query);
+
+    CompressedFile file(outputFileName, options.compression);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "can't open file for write: " << outputFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    QScopedPointer<QTextDecoder> decoder(QTextCodec::codecForName("CP1251")->makeDecoder());
+    JsonOutput output(&file, true);
+    int changedEvents = 0;
+    for (int i = 0; i < events.count() && !IsStopRequested(); ++i) {
+        const RecordIndexEvent event = index.event(events.at(i));
+        DBEvent dbEvent;
+        if (!ReadIndexedEvent(firstDataAddr, lastDataAddr, event, &dbEvent)) {
+            ++changedEvents;
+            continue;
+        }
+        dbEvent.moduleId = event.moduleId;
+
+        // the flags and the links are current, the read flag is changed
+        // in place
+        output.writeEvent(event.offset, dbEvent.flags, index.moduleName(event.moduleId),
+                          dbEvent.ofsNext, dbEvent.ofsPrev,
+                          DecodeEventText(firstDataAddr, dbEvent, decoder.data()),
+                          dbEvent.timestamp);
+    }
+
+    if (!output.finish() || !file.finish()) {
+        std::cerr << "can't write file: " << outputFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    if (options.verbose) {
+        std::cout << "== Query ==" << std::endl;
+        std::cout << "  Indexed events  : " << index.eventCount() << std::endl;
+        std::cout << "  Selected events : " << events.count() << std::endl;
+        std::cout << "  Changed events  : " << changedEvents << std::endl;
+    }
+
+    if (changedEvents) {
+        std::cerr << changedEvents << " indexed events have changed in the database and "
+                  << "are skipped, rebuild the record index: "
+                  << indexFileName.toStdString() << std::endl;
+    }
+
+    if (IsStopRequested()) {
+        std::cerr << "interrupted, the output is partial: " << outputFileName.toStdString() << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,169 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECORDINDEX_H
+#define RECORDINDEX_H
+
+
+#include "miranda.h"
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+
+// The event of the record index: the fields of the header, the contact
+// of the event chain (0 - none) and the interned module id, the blob
+// follows the header in the database
+struct RecordIndexEvent {
+    DWORD offset;
+    DWORD ofsPrev;
+    DWORD ofsNext;
+    DWORD timestamp;
+    DWORD contactId;
+    DWORD flags;
+    DWORD cbBlob;
+    WORD eventType;
+    WORD moduleId;
+};
+
+
+// The read-only record index of the database, the file is mapped into
+// the memory and the records are read in place. The events are sorted
+// by the offset; two orders of their numbers give the events of the
+// contact and the events of the time range by the binary search
+class RecordIndex
+{
+public:
+    RecordIndex();
+    ~RecordIndex();
+
+    bool open(const QString &fileName);
+    void close();
+
+    // the database the index was built for
+    inline qint64 databaseSize() const;
+    inline quint64 databaseHash() const;
+
+    inline int moduleCount() const;
+    inline const QString &moduleName(WORD id) const;
+    inline int contactCount() const;
+    DWORD contactId(int i) const;
+
+    inline int eventCount() const;
+    RecordIndexEvent event(int i) const;
+    // the number of the event at the offset, -1 if there is no event
+    int indexOfEvent(DWORD offset) const;
+    // the numbers of the events of the contact with the timestamps of
+    // [since, until) in the order of the time, until 0 - no bound
+    QVector<int> contactEvents(DWORD contactId, DWORD since, DWORD until) const;
+    // the numbers of the events of [since, until) in the order of the time
+    QVector<int> timeRangeEvents(DWORD since, DWORD until) const;
+
+    inline const QString &errorString() const;
+
+private:
+    Q_DISABLE_COPY(RecordIndex)
+
+    DWORD eventField(int i, int field) const;
+    // the key of the event in the order, see bound()
+    quint64 eventKey(int i, bool byContact) const;
+    // the records are read in place without the bounds checks, so the
+    // offsets must be sorted and the orders must be the sorted numbers
+    // of the events
+    bool isConsistent() const;
+    // the first position of the order whose event has the key not less
+    // (upper - greater) than the key, the key of the event is its
+    // timestamp with the contact in the high half if byContact is set
+    int bound(const uchar *order, bool byContact, quint64 key, bool upper) const;
+
+    QFile m_file;
+    uchar *m_map;
+    qint64 m_databaseSize;
+    quint64 m_databaseHash;
+    QVector<QString> m_moduleNames;
+    int m_contactCount;
+    int m_eventCount;
+    const uchar *m_contacts;
+    const uchar *m_events;
+    const uchar *m_byContact;
+    const uchar *m_byTime;
+    QString m_errorString;
+};
+
+qint64 RecordIndex::databaseSize() const
+{
+    return m_databaseSize;
+}
+
+quint64 RecordIndex::databaseHash() const
+{
+    return m_databaseHash;
+}
+
+int RecordIndex::moduleCount() const
+{
+    return m_moduleNames.count();
+}
+
+const QString &RecordIndex::moduleName(WORD id) const
+{
+    return m_moduleNames.at(id);
+}
+
+int RecordIndex::contactCount() const
+{
+    return m_contactCount;
+}
+
+int RecordIndex::eventCount() const
+{
+    return m_eventCount;
+}
+
+const QString &RecordIndex::errorString() const
+{
+    return m_errorString;
+}
+
+
+// The selection of the query: the events at the offsets (empty - any
+// offset) which pass the filter, only the last events by the time if
+// last isn't 0
+struct RecordQuery {
+    RecordQuery() : last(0) {}
+
+    QVector<DWORD> offsets;
+    RecordFilter filter;
+    int last;
+};
+
+
+// Recovers the database and writes the index of the validated contacts
+// and events. The filters of the options are ignored, the index keeps
+// all records
+bool BuildRecordIndex(const QString &mirandaDbFile,
+                      const QString &indexFileName,
+                      const Miranda2JsonOptions &options);
+
+// Writes the selected messages as the ndjson lines of the events. Only
+// the blobs of the selected events are read from the database, the
+// index must be built for the same database
+bool QueryRecordIndex(const QString &indexFileName,
+                      const QString &mirandaDbFile,
+                      const QString &outputFileName,
+                      const RecordQuery &query,
+                      const Miranda2JsonOptions &options);
+
+
+#endif // RECORDINDEX_H
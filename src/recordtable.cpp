@@ -0,0 +1,181 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recordtable.h"
+
+
+QVector<int> MergeOrder(const QVector<DWORD> &a, const QVector<DWORD> &b)
+{
+    QVector<int> order;
+    order.reserve(a.count() + b.count());
+    int i = 0;
+    int j = 0;
+    while (i < a.count() || j < b.count()) {
+        if (j == b.count() || (i < a.count() && a.at(i) < b.at(j))) {
+            order.append(i++);
+            continue;
+        }
+        if (i < a.count() && a.at(i) == b.at(j)) {
+            ++i;
+        }
+        order.append(~j++);
+    }
+
+    return order;
+}
+
+
+DBEvent EventTable::at(int i) const
+{
+    DBEvent event;
+    event.signature = DBEVENT_SIGNATURE;
+    event.ofsPrev = m_ofsPrev.at(i);
+    event.ofsNext = m_ofsNext.at(i);
+    event.ofsModuleName = m_ofsModuleName.at(i);
+    event.timestamp = m_timestamps.at(i);
+    event.flags = m_flags.at(i);
+    event.eventType = m_eventTypes.at(i);
+    event.cbBlob = m_blobSizes.at(i);
+    event.blob = blob(i);
+    event.moduleId = m_moduleIds.at(i);
+
+    return event;
+}
+
+
+int EventTable::indexOf(DWORD offset) const
+{
+    const DWORD *it = std::lower_bound(m_offsets.constBegin(), m_offsets.constEnd(), offset);
+    if (it == m_offsets.constEnd() || *it != offset) {
+        return -1;
+    }
+
+    return it - m_offsets.constBegin();
+}
+
+
+void EventTable::reserve(int count)
+{
+    m_offsets.reserve(count);
+    m_ofsPrev.reserve(count);
+    m_ofsNext.reserve(count);
+    m_ofsModuleName.reserve(count);
+    m_timestamps.reserve(count);
+    m_flags.reserve(count);
+    m_blobSizes.reserve(count);
+    m_eventTypes.reserve(count);
+    m_moduleIds.reserve(count);
+}
+
+
+void EventTable::append(DWORD offset, const DBEvent &event)
+{
+    Q_ASSERT(event.blob.offset == offset + DBEVENT_HEADER_SIZE);
+
+    int i = m_offsets.count();
+    if (!m_offsets.isEmpty() && m_offsets.last() >= offset) {
+        i = std::lower_bound(m_offsets.constBegin(), m_offsets.constEnd(), offset)
+                - m_offsets.constBegin();
+        if (m_offsets.at(i) == offset) {
+            m_ofsPrev[i] = event.ofsPrev;
+            m_ofsNext[i] = event.ofsNext;
+            m_ofsModuleName[i] = event.ofsModuleName;
+            m_timestamps[i] = event.timestamp;
+            m_flags[i] = event.flags;
+            m_blobSizes[i] = event.blob.size;
+            m_eventTypes[i] = event.eventType;
+            m_moduleIds[i] = event.moduleId;
+            return;
+        }
+    }
+
+    m_offsets.insert(i, offset);
+    m_ofsPrev.insert(i, event.ofsPrev);
+    m_ofsNext.insert(i, event.ofsNext);
+    m_ofsModuleName.insert(i, event.ofsModuleName);
+    m_timestamps.insert(i, event.timestamp);
+    m_flags.insert(i, event.flags);
+    m_blobSizes.insert(i, event.blob.size);
+    m_eventTypes.insert(i, event.eventType);
+    m_moduleIds.insert(i, event.moduleId);
+}
+
+
+int EventTable::remove(const QVector<bool> &removed)
+{
+    const int count = m_offsets.count();
+    RemoveFlagged(removed, &m_offsets);
+    RemoveFlagged(removed, &m_ofsPrev);
+    RemoveFlagged(removed, &m_ofsNext);
+    RemoveFlagged(removed, &m_ofsModuleName);
+    RemoveFlagged(removed, &m_timestamps);
+    RemoveFlagged(removed, &m_flags);
+    RemoveFlagged(removed, &m_blobSizes);
+    RemoveFlagged(removed, &m_eventTypes);
+    RemoveFlagged(removed, &m_moduleIds);
+
+    return count - m_offsets.count();
+}
+
+
+int EventTable::removeBefore(DWORD offset)
+{
+    const int count = CountBefore(m_offsets, offset);
+    m_offsets.remove(0, count);
+    m_ofsPrev.remove(0, count);
+    m_ofsNext.remove(0, count);
+    m_ofsModuleName.remove(0, count);
+    m_timestamps.remove(0, count);
+    m_flags.remove(0, count);
+    m_blobSizes.remove(0, count);
+    m_eventTypes.remove(0, count);
+    m_moduleIds.remove(0, count);
+
+    return count;
+}
+
+
+void EventTable::merge(const EventTable &other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    if (isEmpty() && m_offsets.capacity() < other.count()) {
+        *this = other;
+        return;
+    }
+    if (isEmpty() || m_offsets.last() < other.m_offsets.first()) {
+        m_offsets += other.m_offsets;
+        m_ofsPrev += other.m_ofsPrev;
+        m_ofsNext += other.m_ofsNext;
+        m_ofsModuleName += other.m_ofsModuleName;
+        m_timestamps += other.m_timestamps;
+        m_flags += other.m_flags;
+        m_blobSizes += other.m_blobSizes;
+        m_eventTypes += other.m_eventTypes;
+        m_moduleIds += other.m_moduleIds;
+        return;
+    }
+
+    const QVector<int> order = MergeOrder(m_offsets, other.m_offsets);
+    m_offsets = MergeColumn(order, m_offsets, other.m_offsets);
+    m_ofsPrev = MergeColumn(order, m_ofsPrev, other.m_ofsPrev);
+    m_ofsNext = MergeColumn(order, m_ofsNext, other.m_ofsNext);
+    m_ofsModuleName = MergeColumn(order, m_ofsModuleName, other.m_ofsModuleName);
+    m_timestamps = MergeColumn(order, m_timestamps, other.m_timestamps);
+    m_flags = MergeColumn(order, m_flags, other.m_flags);
+    m_blobSizes = MergeColumn(order, m_blobSizes, other.m_blobSizes);
+    m_eventTypes = MergeColumn(order, m_eventTypes, other.m_eventTypes);
+    m_moduleIds = MergeColumn(order, m_moduleIds, other.m_moduleIds);
+}
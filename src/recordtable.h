@@ -0,0 +1,368 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECORDTABLE_H
+#define RECORDTABLE_H
+
+
+#include "mirandadb.h"
+#include <QVector>
+#include <algorithm>
+
+
+// The records of one type sorted by the offset. The offsets and the
+// records are kept in the contiguous arrays and the record is found by
+// the binary search of its offset. The scanners find the records in the
+// order of the offsets, so the records are appended
+template <typename T>
+class RecordTable
+{
+public:
+    inline int count() const;
+    inline bool isEmpty() const;
+    inline DWORD offset(int i) const;
+    inline const T &at(int i) const;
+    inline T &operator[](int i);
+    inline const QVector<DWORD> &offsets() const;
+
+    // the index of the record at the offset, -1 if there is no record
+    int indexOf(DWORD offset) const;
+    inline bool contains(DWORD offset) const;
+    // the record at the offset or the default one
+    T value(DWORD offset) const;
+
+    void reserve(int count);
+    // the offset must not be less than the last one, the record at the
+    // same offset is replaced
+    void append(DWORD offset, const T &record);
+    void insert(DWORD offset, const T &record);
+    // removes the records with the set flag, returns their number
+    int remove(const QVector<bool> &removed);
+    // removes the records before the offset, returns their number
+    int removeBefore(DWORD offset);
+
+    // merges the other table, the record of the other table replaces the
+    // one at the same offset. The table which follows the last record is
+    // appended; the empty table shares the arrays of the other one unless
+    // the space for it is reserved
+    void merge(const RecordTable<T> &other);
+
+private:
+    QVector<DWORD> m_offsets;
+    QVector<T> m_records;
+};
+
+
+// The events in the columns: the passes over the events read only the
+// columns they need, and the event takes 32 bytes instead of the node
+// of the hash. The blob isn't kept, it follows the header of the event
+class EventTable
+{
+public:
+    inline int count() const;
+    inline bool isEmpty() const;
+    inline DWORD offset(int i) const;
+    inline const QVector<DWORD> &offsets() const;
+
+    inline DWORD ofsPrev(int i) const;
+    inline DWORD ofsNext(int i) const;
+    inline DWORD ofsModuleName(int i) const;
+    inline DWORD timestamp(int i) const;
+    inline DWORD flags(int i) const;
+    inline WORD eventType(int i) const;
+    inline DBView blob(int i) const;
+    inline WORD moduleId(int i) const;
+    inline void setModuleId(int i, WORD moduleId);
+
+    // the event of the columns
+    DBEvent at(int i) const;
+
+    int indexOf(DWORD offset) const;
+    inline bool contains(DWORD offset) const;
+
+    void reserve(int count);
+    // the event must be read by ReadDBEvent(), see RecordTable::append()
+    // and RecordTable::insert()
+    void append(DWORD offset, const DBEvent &event);
+    int remove(const QVector<bool> &removed);
+    int removeBefore(DWORD offset);
+    // see RecordTable::merge()
+    void merge(const EventTable &other);
+
+private:
+    QVector<DWORD> m_offsets;
+    QVector<DWORD> m_ofsPrev;
+    QVector<DWORD> m_ofsNext;
+    QVector<DWORD> m_ofsModuleName;
+    QVector<DWORD> m_timestamps;
+    QVector<DWORD> m_flags;
+    QVector<DWORD> m_blobSizes;
+    QVector<WORD> m_eventTypes;
+    QVector<WORD> m_moduleIds;
+};
+
+
+// removes the elements with the set flags, keeps the order of the rest
+template <typename T>
+static void RemoveFlagged(const QVector<bool> &removed, QVector<T> *values)
+{
+    int to = 0;
+    for (int from = 0; from < values->count(); ++from) {
+        if (!removed.at(from)) {
+            (*values)[to++] = values->at(from);
+        }
+    }
+    values->resize(to);
+}
+
+
+// The order of the merged sorted offsets: the index in a for the element
+// of a, ~index in b for the element of b. The element of b replaces the
+// element of a at the same offset
+QVector<int> MergeOrder(const QVector<DWORD> &a, const QVector<DWORD> &b);
+
+// the column merged in the order, see above
+template <typename T>
+static QVector<T> MergeColumn(const QVector<int> &order,
+                              const QVector<T> &a, const QVector<T> &b)
+{
+    QVector<T> merged;
+    merged.reserve(order.count());
+    for (int i = 0; i < order.count(); ++i) {
+        const int j = order.at(i);
+        merged.append((j >= 0) ? a.at(j) : b.at(~j));
+    }
+
+    return merged;
+}
+
+// the number of the sorted offsets before the offset
+inline int CountBefore(const QVector<DWORD> &offsets, DWORD offset)
+{
+    return std::lower_bound(offsets.constBegin(), offsets.constEnd(), offset)
+            - offsets.constBegin();
+}
+
+
+template <typename T>
+int RecordTable<T>::count() const
+{
+    return m_offsets.count();
+}
+
+template <typename T>
+bool RecordTable<T>::isEmpty() const
+{
+    return m_offsets.isEmpty();
+}
+
+template <typename T>
+DWORD RecordTable<T>::offset(int i) const
+{
+    return m_offsets.at(i);
+}
+
+template <typename T>
+const T &RecordTable<T>::at(int i) const
+{
+    return m_records.at(i);
+}
+
+template <typename T>
+T &RecordTable<T>::operator[](int i)
+{
+    return m_records[i];
+}
+
+template <typename T>
+const QVector<DWORD> &RecordTable<T>::offsets() const
+{
+    return m_offsets;
+}
+
+template <typename T>
+int RecordTable<T>::indexOf(DWORD offset) const
+{
+    const DWORD *it = std::lower_bound(m_offsets.constBegin(), m_offsets.constEnd(), offset);
+    if (it == m_offsets.constEnd() || *it != offset) {
+        return -1;
+    }
+
+    return it - m_offsets.constBegin();
+}
+
+template <typename T>
+bool RecordTable<T>::contains(DWORD offset) const
+{
+    return indexOf(offset) != -1;
+}
+
+template <typename T>
+T RecordTable<T>::value(DWORD offset) const
+{
+    const int i = indexOf(offset);
+    return (i == -1) ? T() : m_records.at(i);
+}
+
+template <typename T>
+void RecordTable<T>::reserve(int count)
+{
+    m_offsets.reserve(count);
+    m_records.reserve(count);
+}
+
+template <typename T>
+void RecordTable<T>::append(DWORD offset, const T &record)
+{
+    if (!m_offsets.isEmpty() && m_offsets.last() >= offset) {
+        insert(offset, record);
+        return;
+    }
+
+    m_offsets.append(offset);
+    m_records.append(record);
+}
+
+template <typename T>
+void RecordTable<T>::insert(DWORD offset, const T &record)
+{
+    const int i = std::lower_bound(m_offsets.constBegin(), m_offsets.constEnd(), offset)
+            - m_offsets.constBegin();
+    if (i < m_offsets.count() && m_offsets.at(i) == offset) {
+        m_records[i] = record;
+        return;
+    }
+
+    m_offsets.insert(i, offset);
+    m_records.insert(i, record);
+}
+
+template <typename T>
+int RecordTable<T>::remove(const QVector<bool> &removed)
+{
+    const int count = m_offsets.count();
+    RemoveFlagged(removed, &m_offsets);
+    RemoveFlagged(removed, &m_records);
+
+    return count - m_offsets.count();
+}
+
+template <typename T>
+int RecordTable<T>::removeBefore(DWORD offset)
+{
+    const int count = CountBefore(m_offsets, offset);
+    m_offsets.remove(0, count);
+    m_records.remove(0, count);
+
+    return count;
+}
+
+template <typename T>
+void RecordTable<T>::merge(const RecordTable<T> &other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    if (isEmpty() && m_offsets.capacity() < other.count()) {
+        *this = other;
+        return;
+    }
+    if (isEmpty() || m_offsets.last() < other.m_offsets.first()) {
+        m_offsets += other.m_offsets;
+        m_records += other.m_records;
+        return;
+    }
+
+    const QVector<int> order = MergeOrder(m_offsets, other.m_offsets);
+    m_offsets = MergeColumn(order, m_offsets, other.m_offsets);
+    m_records = MergeColumn(order, m_records, other.m_records);
+}
+
+
+int EventTable::count() const
+{
+    return m_offsets.count();
+}
+
+bool EventTable::isEmpty() const
+{
+    return m_offsets.isEmpty();
+}
+
+DWORD EventTable::offset(int i) const
+{
+    return m_offsets.at(i);
+}
+
+const QVector<DWORD> &EventTable::offsets() const
+{
+    return m_offsets;
+}
+
+DWORD EventTable::ofsPrev(int i) const
+{
+    return m_ofsPrev.at(i);
+}
+
+DWORD EventTable::ofsNext(int i) const
+{
+    return m_ofsNext.at(i);
+}
+
+DWORD EventTable::ofsModuleName(int i) const
+{
+    return m_ofsModuleName.at(i);
+}
+
+DWORD EventTable::timestamp(int i) const
+{
+    return m_timestamps.at(i);
+}
+
+DWORD EventTable::flags(int i) const
+{
+    return m_flags.at(i);
+}
+
+WORD EventTable::eventType(int i) const
+{
+    return m_eventTypes.at(i);
+}
+
+DBView EventTable::blob(int i) const
+{
+    DBView view;
+    view.offset = m_offsets.at(i) + DBEVENT_HEADER_SIZE;
+    view.size = m_blobSizes.at(i);
+
+    return view;
+}
+
+WORD EventTable::moduleId(int i) const
+{
+    return m_moduleIds.at(i);
+}
+
+void EventTable::setModuleId(int i, WORD moduleId)
+{
+    m_moduleIds[i] = moduleId;
+}
+
+bool EventTable::contains(DWORD offset) const
+{
+    return indexOf(offset) != -1;
+}
+
+
+#endif // RECORDTABLE_H
@@ -0,0 +1,144 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recordvalidator.h"
+
+
+// the link outside of the image is worse than the link to the wrong
+// record, but the one damaged link doesn't reject the record alone
+static const int OUT_OF_IMAGE_SCORE = -2;
+// the score of the strong record
+static const int STRONG_SCORE = 2;
+
+// the messages are between the first release of miranda and 2100
+static const DWORD MIN_TIMESTAMP = 946684800;
+static const DWORD MAX_TIMESTAMP = 4102444800u;
+
+
+// the links of the one record, the link is 0 (the end of the chain) or
+// the offset of the record with the signature
+class LinkScore
+{
+public:
+    LinkScore(const BYTE *firstDataAddr, const BYTE *lastDataAddr, bool checkLinks)
+        : m_firstDataAddr(firstDataAddr), m_lastDataAddr(lastDataAddr),
+          m_checkLinks(checkLinks)
+    {
+    }
+
+    int operator()(DWORD link, DWORD signature) const
+    {
+        if (link == 0 || !m_checkLinks) {
+            return 0;
+        }
+        if (link + Q_INT64_C(4) > m_lastDataAddr - m_firstDataAddr) {
+            return OUT_OF_IMAGE_SCORE;
+        }
+
+        return ReadSignature(m_firstDataAddr + link) == signature ? 1 : -1;
+    }
+
+    // the module name is required, so its absence is penalized
+    int moduleName(DWORD link) const
+    {
+        if (link == 0) {
+            return -1;
+        }
+
+        return (*this)(link, DBMODULENAME_SIGNATURE);
+    }
+
+private:
+    const BYTE *m_firstDataAddr;
+    const BYTE *m_lastDataAddr;
+    bool m_checkLinks;
+};
+
+
+static RecordConfidence Confidence(int score)
+{
+    if (score < 0) {
+        return WeakRecord;
+    }
+    if (score >= STRONG_SCORE) {
+        return StrongRecord;
+    }
+
+    return PlausibleRecord;
+}
+
+
+RecordConfidence ValidateDBContact(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                   const DBContact &contact, bool checkLinks)
+{
+    const LinkScore linkScore(firstDataAddr, lastDataAddr, checkLinks);
+    int score = 0;
+    score += linkScore(contact.ofsNext, DBCONTACT_SIGNATURE);
+    score += linkScore(contact.ofsFirstSettings, DBCONTACTSETTINGS_SIGNATURE);
+    score += linkScore(contact.ofsFirstEvent, DBEVENT_SIGNATURE);
+    score += linkScore(contact.ofsLastEvent, DBEVENT_SIGNATURE);
+    score += linkScore(contact.ofsFirstUnreadEvent, DBEVENT_SIGNATURE);
+
+    // the contact without the events has no chain
+    if ((contact.eventCount == 0) != (contact.ofsFirstEvent == 0)) {
+        --score;
+    }
+
+    return Confidence(score);
+}
+
+
+RecordConfidence ValidateDBEvent(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                 const DBEvent &event, bool checkLinks)
+{
+    const LinkScore linkScore(firstDataAddr, lastDataAddr, checkLinks);
+    int score = 0;
+    score += linkScore(event.ofsPrev, DBEVENT_SIGNATURE);
+    score += linkScore(event.ofsNext, DBEVENT_SIGNATURE);
+    score += linkScore.moduleName(event.ofsModuleName);
+    score += (event.timestamp >= MIN_TIMESTAMP && event.timestamp <= MAX_TIMESTAMP) ? 1 : -1;
+
+    return Confidence(score);
+}
+
+
+RecordConfidence ValidateDBModuleName(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                      const DBModuleName &moduleName, bool checkLinks)
+{
+    const LinkScore linkScore(firstDataAddr, lastDataAddr, checkLinks);
+    int score = linkScore(moduleName.ofsNext, DBMODULENAME_SIGNATURE);
+
+    // the names are the printable ascii identifiers
+    const BYTE *name = ViewData(firstDataAddr, moduleName.name);
+    bool printable = moduleName.name.size > 0;
+    for (DWORD i = 0; i < moduleName.name.size && printable; ++i) {
+        printable = (name[i] >= 0x20 && name[i] < 0x7F);
+    }
+    score += printable ? 2 : -2;
+
+    return Confidence(score);
+}
+
+
+RecordConfidence ValidateDBContactSettings(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                           const DBContactSettings &settings, bool checkLinks)
+{
+    const LinkScore linkScore(firstDataAddr, lastDataAddr, checkLinks);
+    int score = 0;
+    score += linkScore(settings.ofsNext, DBCONTACTSETTINGS_SIGNATURE);
+    score += linkScore.moduleName(settings.ofsModuleName);
+    score += settings.cbBlob > 0 ? 1 : -1;
+
+    return Confidence(score);
+}
@@ -0,0 +1,49 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECORDVALIDATOR_H
+#define RECORDVALIDATOR_H
+
+
+#include "mirandadb.h"
+
+
+// The confidence of the carved record. The links of the record are
+// cross-checked against the size of the image and the signatures of the
+// records they point at, the other fields are checked for the plausible
+// values. The negative score makes the record weak, the link which points
+// outside of the image costs the most: the most of the weak records are
+// the signatures found inside the texts. The strong record is trusted
+// enough to skip its interior.
+// The links are checked only if checkLinks is set: they are the offsets
+// inside the database, so they mean nothing if the image isn't the
+// database (the window of the raw disk image)
+enum RecordConfidence {
+    WeakRecord,
+    PlausibleRecord,
+    StrongRecord
+};
+
+
+RecordConfidence ValidateDBContact(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                   const DBContact &contact, bool checkLinks);
+RecordConfidence ValidateDBEvent(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                 const DBEvent &event, bool checkLinks);
+RecordConfidence ValidateDBModuleName(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                      const DBModuleName &moduleName, bool checkLinks);
+RecordConfidence ValidateDBContactSettings(const BYTE *firstDataAddr, const BYTE *lastDataAddr,
+                                           const DBContactSettings &settings, bool checkLinks);
+
+
+#endif // RECORDVALIDATOR_H
@@ -0,0 +1,224 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recoverystats.h"
+#include "jsonwriter.h"
+#include "signaturescanner.h"
+#include <QFile>
+#include <ctime>
+#include <iostream>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+
+static const char *const PHASE_NAMES[RecoveryStats::PhaseCount] = {
+    "read", "scan", "settings", "decode", "serialize"
+};
+
+static const char *const RECORD_TYPE_NAMES[RecordTypeCount] = {
+    "contacts", "events", "module_names", "contact_settings"
+};
+
+
+qint64 ProcessCpuTime()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * Q_INT64_C(1000000)
+                + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+#endif
+    return std::clock() * Q_INT64_C(1000000) / CLOCKS_PER_SEC;
+}
+
+
+qint64 PeakResidentSize()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MAC
+        return usage.ru_maxrss;
+#else
+        return usage.ru_maxrss * Q_INT64_C(1024);
+#endif
+    }
+#endif
+    return 0;
+}
+
+
+RecoveryStats::RecoveryStats()
+    : m_cpuStart(0), m_decodeNsecs(0), m_inputBytes(0), m_scannedBytes(0),
+      m_outputBytes(0), m_duplicates(0)
+{
+    for (int i = 0; i < PhaseCount; ++i) {
+        m_wall[i] = 0;
+        m_cpu[i] = 0;
+    }
+}
+
+
+void RecoveryStats::begin(Phase phase)
+{
+    stop();
+    m_running.append(phase);
+    m_wallTimer.start();
+    m_cpuStart = ProcessCpuTime();
+}
+
+
+void RecoveryStats::end(Phase phase)
+{
+    if (m_running.isEmpty() || m_running.last() != phase) {
+        return;
+    }
+
+    // the outer phase continues
+    stop();
+    m_running.removeLast();
+    m_wallTimer.start();
+    m_cpuStart = ProcessCpuTime();
+}
+
+
+void RecoveryStats::stop()
+{
+    if (!m_running.isEmpty()) {
+        const Phase phase = m_running.last();
+        m_wall[phase] += m_wallTimer.nsecsElapsed() / 1000;
+        m_cpu[phase] += ProcessCpuTime() - m_cpuStart;
+    }
+}
+
+
+void RecoveryStats::setInputBytes(qint64 bytes)
+{
+    m_inputBytes = bytes;
+}
+
+
+void RecoveryStats::setScannedBytes(qint64 bytes)
+{
+    m_scannedBytes = bytes;
+}
+
+
+void RecoveryStats::setOutputBytes(qint64 bytes)
+{
+    m_outputBytes = bytes;
+}
+
+
+void RecoveryStats::setCounters(const CarveCounters &counters)
+{
+    m_counters = counters;
+}
+
+
+void RecoveryStats::setDuplicates(int duplicates)
+{
+    m_duplicates = duplicates;
+}
+
+
+bool RecoveryStats::write(const QString &fileName) const
+{
+    QFile file;
+    bool opened = false;
+    if (fileName == "-") {
+        opened = file.open(stderr, QIODevice::WriteOnly);
+    }
+    else {
+        file.setFileName(fileName);
+        opened = file.open(QIODevice::WriteOnly);
+    }
+    if (!opened) {
+        std::cerr << "can't open file for write: " << fileName.toStdString() << std::endl;
+        return false;
+    }
+
+    qint64 exceptions = 0;
+    JsonWriter writer(&file, 4096);
+    writer.beginObject();
+    writer.writeKey("scanner");
+    writer.writeString(QString(RecordSignatureScannerName()));
+
+    // the decoding is measured inside the serialization, see addDecodeTime()
+    qint64 wall[PhaseCount];
+    for (int i = 0; i < PhaseCount; ++i) {
+        wall[i] = m_wall[i];
+    }
+    wall[DecodePhase] = m_decodeNsecs / 1000;
+    wall[SerializePhase] = qMax<qint64>(0, wall[SerializePhase] - wall[DecodePhase]);
+
+    // the time is in microseconds, the decoding has no cpu time
+    writer.writeKey("phases");
+    writer.beginObject();
+    for (int i = 0; i < PhaseCount; ++i) {
+        writer.writeKey(PHASE_NAMES[i]);
+        writer.beginObject();
+        writer.writeKey("wall_us");
+        writer.writeNumber(wall[i]);
+        if (i != DecodePhase) {
+            writer.writeKey("cpu_us");
+            writer.writeNumber(m_cpu[i]);
+        }
+        writer.endObject();
+    }
+    writer.endObject();
+
+    // each failed record is the exception thrown by the reader
+    writer.writeKey("records");
+    writer.beginObject();
+    for (int i = 0; i < RecordTypeCount; ++i) {
+        writer.writeKey(RECORD_TYPE_NAMES[i]);
+        writer.beginObject();
+        writer.writeKey("signature_hits");
+        writer.writeNumber(m_counters.hits[i]);
+        writer.writeKey("parsed");
+        writer.writeNumber(m_counters.hits[i] - m_counters.failures[i]);
+        writer.writeKey("weak");
+        writer.writeNumber(m_counters.weak[i]);
+        writer.writeKey("filtered");
+        writer.writeNumber(m_counters.filtered[i]);
+        writer.endObject();
+        exceptions += m_counters.failures[i];
+    }
+    writer.endObject();
+
+    writer.writeKey("exceptions");
+    writer.writeNumber(exceptions);
+    writer.writeKey("duplicates");
+    writer.writeNumber(m_duplicates);
+    writer.writeKey("input_bytes");
+    writer.writeNumber(m_inputBytes);
+    writer.writeKey("scanned_bytes");
+    writer.writeNumber(m_scannedBytes);
+    writer.writeKey("output_bytes");
+    writer.writeNumber(m_outputBytes);
+    writer.writeKey("peak_rss_bytes");
+    writer.writeNumber(PeakResidentSize());
+    writer.endObject();
+    writer.endLine();
+
+    if (!writer.flush()) {
+        std::cerr << "can't write file: " << fileName.toStdString() << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,115 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECOVERYSTATS_H
+#define RECOVERYSTATS_H
+
+
+#include "recordcarver.h"
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+
+// The report of the recovery: the wall and cpu time of each phase, the
+// carving counters and the sizes. The phases are exclusive: the phase
+// which begins inside the other one pauses it. The cpu time is taken
+// only at the boundaries of the phases and it's the time of all threads,
+// so the carving and the compression threads are counted in their phases.
+// The texts are decoded lazily per event inside the serialization, so
+// the decoding is measured only by the wall time, see addDecodeTime(),
+// which is excluded from the serialization; its cpu time stays there
+class RecoveryStats
+{
+public:
+    enum Phase {
+        ReadPhase,
+        ScanPhase,
+        SettingsPhase,
+        DecodePhase,        // measured by addDecodeTime() only
+        SerializePhase,
+        PhaseCount
+    };
+
+    RecoveryStats();
+
+    void begin(Phase phase);
+    void end(Phase phase);
+    // the wall time of the text decoding inside the serialization
+    inline void addDecodeTime(qint64 nsecs);
+
+    void setInputBytes(qint64 bytes);
+    void setScannedBytes(qint64 bytes);
+    void setOutputBytes(qint64 bytes);
+    void setCounters(const CarveCounters &counters);
+    void setDuplicates(int duplicates);
+
+    // Writes the json report to the file, "-" is the standard error
+    bool write(const QString &fileName) const;
+
+private:
+    void stop();
+
+    qint64 m_wall[PhaseCount];
+    qint64 m_cpu[PhaseCount];
+    QVector<Phase> m_running;
+    QElapsedTimer m_wallTimer;
+    qint64 m_cpuStart;
+    qint64 m_decodeNsecs;
+    qint64 m_inputBytes;
+    qint64 m_scannedBytes;
+    qint64 m_outputBytes;
+    CarveCounters m_counters;
+    qint64 m_duplicates;
+};
+
+void RecoveryStats::addDecodeTime(qint64 nsecs)
+{
+    m_decodeNsecs += nsecs;
+}
+
+
+// Measures the phase of the scope, does nothing without the stats
+class PhaseTimer
+{
+public:
+    PhaseTimer(RecoveryStats *stats, RecoveryStats::Phase phase)
+        : m_stats(stats), m_phase(phase)
+    {
+        if (m_stats) {
+            m_stats->begin(m_phase);
+        }
+    }
+
+    ~PhaseTimer()
+    {
+        if (m_stats) {
+            m_stats->end(m_phase);
+        }
+    }
+
+private:
+    RecoveryStats *m_stats;
+    RecoveryStats::Phase m_phase;
+};
+
+
+// The cpu time of the process (all threads) in microseconds
+qint64 ProcessCpuTime();
+
+// The peak resident set size of the process in bytes, 0 if unknown
+qint64 PeakResidentSize();
+
+
+#endif // RECOVERYSTATS_H
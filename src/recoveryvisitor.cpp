@@ -0,0 +1,255 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "recoveryvisitor.h"
+#include "chainwalker.h"
+#include "eventtext.h"
+#include "extractionschema.h"
+#include "mirandadbimage.h"
+#include "recorddedup.h"
+#include "progress.h"
+#include "recordcarver.h"
+#include "recoverystats.h"
+#include "scanindex.h"
+#include "signaturescanner.h"
+#include "textindex.h"
+#include "textsanitizer.h"
+#include <QElapsedTimer>
+#include <QScopedPointer>
+#include <QTextCodec>
+#include <cstring>
+#include <iostream>
+
+
+EventView::EventView(const BYTE *firstDataAddr, DWORD id, const DBEvent &event,
+                     const QString &moduleName, DWORD contactId,
+                     QTextDecoder *decoder, RecoveryStats *stats)
+    : m_firstDataAddr(firstDataAddr), m_id(id), m_event(event),
+      m_moduleName(moduleName), m_contactId(contactId), m_decoder(decoder),
+      m_stats(stats), m_textDecoded(false)
+{
+}
+
+
+QString EventView::text() const
+{
+    if (!m_textDecoded) {
+        // the phase timer would take the cpu time of each event
+        QElapsedTimer timer;
+        if (m_stats) {
+            timer.start();
+        }
+        m_text = DecodeEventText(m_firstDataAddr, m_event, m_decoder);
+        m_textDecoded = true;
+        if (m_stats) {
+            m_stats->addDecodeTime(timer.nsecsElapsed());
+        }
+    }
+
+    return m_text;
+}
+
+
+bool VisitMirandaDb(const QString &mirandaDbFile,
+                    const Miranda2JsonOptions &options,
+                    RecoveryVisitor *visitor,
+                    RecoveryStats *stats)
+{
+    // for decoding russian text inside the miranda db
+    QScopedPointer<QTextDecoder> decoder(QTextCodec::codecForName("CP1251")->makeDecoder());
+
+    MirandaDbImage image;
+    if (stats) {
+        stats->begin(RecoveryStats::ReadPhase);
+    }
+    const bool opened = image.open(mirandaDbFile, options.mapInput, options.hugePages);
+    if (stats) {
+        stats->end(RecoveryStats::ReadPhase);
+    }
+    if (!opened) {
+        std::cerr << "can't open file for read: " << mirandaDbFile.toStdString()
+                  << " (" << image.errorString().toStdString() << ")" << std::endl;
+        return false;
+    }
+
+    // minimum file size
+    if (image.size() < static_cast<qint64>(sizeof(DBHeader))) {
+        std::cerr << "it's not a miranda database" << std::endl;
+        return false;
+    }
+
+    // magic
+    DBHeader header = ReadDBHeader(image.data());
+    if (strcmp((const char *)header.signature, DBHEADER_SIGNATURE)) {
+        std::cerr << "it's not a miranda database" << std::endl;
+        return false;
+    }
+
+    // read the database structures by brutforce algorithm
+    // we find the magic and try to read structure, the candidates of
+    // the magic are found by the vectorized scanner. In the walk mode
+    // only the ranges which are not reachable by the links are carved,
+    // with the scan index only the blocks changed since the previous run
+    const BYTE *const firstDataAddr = image.data();
+    const BYTE *const lastDataAddr = firstDataAddr + image.size();
+
+    CarveOptions carveOptions;
+    carveOptions.rescanInterior = options.rescanInterior;
+    carveOptions.includeWeak = options.includeWeak;
+    carveOptions.filter = &options.filter;
+
+    DBRecords records;
+    qint64 carvedBytes = image.size();
+    {
+        PhaseTimer scanTimer(stats, RecoveryStats::ScanPhase);
+        if (options.walkChains) {
+            if (options.scanIndex) {
+                std::cerr << "the scan index is ignored in the walk mode" << std::endl;
+            }
+            carvedBytes = WalkRecords(firstDataAddr, lastDataAddr, header,
+                                      options.threadCount, carveOptions, &records);
+        }
+        else if (options.scanIndex && !options.indexFileName.isEmpty()) {
+            carvedBytes = CarveRecordsIncremental(firstDataAddr, lastDataAddr, header,
+                                                  options.indexFileName,
+                                                  options.threadCount, carveOptions, &records);
+        }
+        else {
+            if (options.scanIndex) {
+                std::cerr << "the scan index file isn't set, the database is scanned entirely" << std::endl;
+            }
+            CarveRecords(firstDataAddr, lastDataAddr, options.threadCount,
+                         carveOptions, &records);
+        }
+    }
+
+    // the contacts can't be filtered before the chains are known
+    FilterContacts(options.filter, header.ofsUser, &records);
+
+    int duplicates = 0;
+    if (!options.keepDuplicates) {
+        PhaseTimer dedupTimer(stats, RecoveryStats::ScanPhase);
+        duplicates = DeduplicateEvents(firstDataAddr, &records);
+    }
+    if (stats) {
+        stats->setInputBytes(image.size());
+        stats->setScannedBytes(carvedBytes);
+        stats->setCounters(records.counters);
+        stats->setDuplicates(duplicates);
+    }
+
+    RecordTable<DBContact> &dbContacts = records.contacts;
+    const EventTable &dbEvents = records.events;
+    const ModuleNameTable &moduleNameTable = records.moduleNameTable;
+
+    if (options.verbose) {
+        std::cout << "== Found ==" << std::endl;
+        std::cout << "  Scanner          : " << RecordSignatureScannerName() << std::endl;
+        std::cout << "  Text sanitizer   : " << TextSanitizerName() << std::endl;
+        std::cout << "  Carved bytes     : " << carvedBytes << " of " << image.size() << std::endl;
+        std::cout << "  DBContact        : " << dbContacts.count()  << std::endl;
+        std::cout << "  DBEvent          : " << dbEvents.count() << std::endl;
+        std::cout << "  DBModuleName     : " << records.moduleNames.count() << std::endl;
+        std::cout << "  DBContactSettings: " << records.contactSettings.count() << std::endl;
+        std::cout << "  Weak records     : " << records.weakRecords.count() << std::endl;
+        std::cout << "  Filtered events  : " << records.counters.filtered[EventRecord] << std::endl;
+        std::cout << "  Duplicate events : " << duplicates << std::endl;
+        std::cout << "  Module names     : " << moduleNameTable.count() - 1 << std::endl;
+    }
+
+    // the user contact is the part of the contact list even if it
+    // was not found, the settings of all contacts are decoded once.
+    // The records are handed out in the order of the offsets
+    if (!dbContacts.contains(header.ofsUser)) {
+        dbContacts.insert(header.ofsUser, DBContact());
+    }
+    const QVector<DWORD> &contactIds = dbContacts.offsets();
+
+    // only the settings of the schema are decoded, the other values are
+    // skipped
+    QScopedPointer<SettingsFilter> filter;
+    if (visitor->schema()) {
+        filter.reset(new SettingsFilter(*visitor->schema(), moduleNameTable));
+    }
+    if (stats) {
+        stats->begin(RecoveryStats::SettingsPhase);
+    }
+    const QVector<ContactSettings> settings = ResolveSettings(firstDataAddr, records,
+                                                              contactIds, options.threadCount,
+                                                              filter.data());
+    if (stats) {
+        stats->end(RecoveryStats::SettingsPhase);
+    }
+
+    QVector<DWORD> eventOwners;
+    if (visitor->eventOwnersRequired()) {
+        eventOwners = EventOwners(records);
+    }
+
+    // the consumers write the output while the records are handed out
+    PhaseTimer serializeTimer(stats, RecoveryStats::SerializePhase);
+    visitor->onBegin(header);
+    for (int id = 0; id < moduleNameTable.count(); ++id) {
+        visitor->onModule(id, moduleNameTable.name(id));
+    }
+
+    for (int i = 0; i < contactIds.count(); ++i) {
+        const DWORD id = contactIds.at(i);
+        visitor->onContact(id, dbContacts.at(i));
+        visitor->onSettings(id, settings.at(i));
+    }
+
+    // the text of the message is decoded once for the text index and
+    // for the visitor
+    QScopedPointer<TextIndexBuilder> textIndex;
+    if (options.textIndex && !options.textIndexFileName.isEmpty()) {
+        textIndex.reset(new TextIndexBuilder);
+    }
+
+    // the interrupt stops the scan only, all the events which are already
+    // found are written, the second interrupt kills the process
+    ProgressAddTotalEvents(dbEvents.count());
+    for (int i = 0; i < dbEvents.count(); ++i) {
+        ProgressAddWrittenEvents(1);
+
+        const DBEvent event = dbEvents.at(i);
+        const EventView view(firstDataAddr, dbEvents.offset(i), event,
+                             moduleNameTable.name(event.moduleId),
+                             eventOwners.isEmpty() ? 0 : eventOwners.at(i),
+                             decoder.data(), stats);
+        if (textIndex && view.isMessage()) {
+            textIndex->addEvent(view.id(), event.timestamp, view.text());
+        }
+        visitor->onEvent(view);
+    }
+
+    if (!visitor->onEnd()) {
+        return false;
+    }
+
+    // the index of the interrupted scan would miss the messages
+    if (textIndex && !IsStopRequested()) {
+        if (!textIndex->write(options.textIndexFileName)) {
+            std::cerr << "can't write file: " << options.textIndexFileName.toStdString() << std::endl;
+            return false;
+        }
+        if (options.verbose) {
+            std::cout << "== Text index ==" << std::endl;
+            std::cout << "  Messages         : " << textIndex->eventCount() << std::endl;
+            std::cout << "  Terms            : " << textIndex->termCount() << std::endl;
+        }
+    }
+
+    return true;
+}
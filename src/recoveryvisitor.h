@@ -0,0 +1,136 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef RECOVERYVISITOR_H
+#define RECOVERYVISITOR_H
+
+
+#include "contactsettings.h"
+#include "miranda.h"
+#include "mirandadb.h"
+#include <QString>
+class ExtractionSchema;
+class QTextDecoder;
+class RecoveryStats;
+
+
+// The event which is handed to the visitor. It refers to the database
+// image, so it's valid only inside the callback; the text is decoded
+// only if it's requested
+class EventView
+{
+public:
+    EventView(const BYTE *firstDataAddr, DWORD id, const DBEvent &event,
+              const QString &moduleName, DWORD contactId,
+              QTextDecoder *decoder, RecoveryStats *stats);
+
+    inline DWORD id() const;
+    inline const DBEvent &event() const;
+    inline const QString &moduleName() const;
+    // the contact of the event chain, 0 - the event isn't in a chain or
+    // the visitor doesn't require the owners
+    inline DWORD contactId() const;
+    // the raw blob, see DBEvent
+    inline const BYTE *blob() const;
+    inline DWORD blobSize() const;
+    // only the messages are written to the outputs
+    inline bool isMessage() const;
+
+    // decodes the text on the first call, see DecodeEventText()
+    QString text() const;
+
+private:
+    const BYTE *m_firstDataAddr;
+    DWORD m_id;
+    const DBEvent &m_event;
+    const QString &m_moduleName;
+    DWORD m_contactId;
+    QTextDecoder *m_decoder;
+    RecoveryStats *m_stats;
+    mutable QString m_text;
+    mutable bool m_textDecoded;
+};
+
+DWORD EventView::id() const
+{
+    return m_id;
+}
+
+const DBEvent &EventView::event() const
+{
+    return m_event;
+}
+
+const QString &EventView::moduleName() const
+{
+    return m_moduleName;
+}
+
+DWORD EventView::contactId() const
+{
+    return m_contactId;
+}
+
+const BYTE *EventView::blob() const
+{
+    return ViewData(m_firstDataAddr, m_event.blob);
+}
+
+DWORD EventView::blobSize() const
+{
+    return m_event.blob.size;
+}
+
+bool EventView::isMessage() const
+{
+    return IsMessageEvent(m_event.eventType);
+}
+
+
+// The consumer of the recovered records. The records are handed out in
+// the order of the offsets: the module names, then each contact followed
+// by its settings, then the events. The user contact is always handed
+// out even if it isn't found
+class RecoveryVisitor
+{
+public:
+    virtual ~RecoveryVisitor() {}
+
+    // the settings which are decoded for onSettings(), 0 - all settings
+    virtual const ExtractionSchema *schema() const { return 0; }
+    // the events are handed out with their contacts, see EventOwners()
+    virtual bool eventOwnersRequired() const { return false; }
+
+    virtual void onBegin(const DBHeader & /* header */) {}
+    virtual void onModule(WORD /* id */, const QString & /* name */) {}
+    virtual void onContact(DWORD /* id */, const DBContact & /* contact */) {}
+    virtual void onSettings(DWORD /* contactId */, const ContactSettings & /* settings */) {}
+    virtual void onEvent(const EventView & /* event */) {}
+    // returns false if the visitor failed, the error is already reported
+    virtual bool onEnd() { return true; }
+};
+
+
+// Recovers the records of the miranda database and hands them to the
+// visitor, the options select the way of the recovery. The interrupted
+// recovery (see IsStopRequested()) hands out the records which are
+// already found. Returns false if the database can't be read or the
+// visitor failed
+bool VisitMirandaDb(const QString &mirandaDbFile,
+                    const Miranda2JsonOptions &options,
+                    RecoveryVisitor *visitor,
+                    RecoveryStats *stats = 0);
+
+
+#endif // RECOVERYVISITOR_H
@@ -0,0 +1,241 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "scanindex.h"
+#include "fasthash.h"
+#include "progress.h"
+#include <QFile>
+#include <QSaveFile>
+#include <cstring>
+#include <iostream>
+
+
+// the format of the index file (all numbers are little-endian):
+//   magic[8], blockSize, flags, ofsFileEnd, fileSize (low, high), blockCount
+//   for each block: hash (low, high), signatureCount,
+//                   signatureCount * (offset, signature)
+static const char SCANINDEX_MAGIC[] = "MDBIDX02";
+static const int SCANINDEX_MAGIC_SIZE = 8;
+static const DWORD SCANINDEX_BLOCK_SIZE = 1024 * 1024;
+
+// the signature which begins in the last bytes of the block ends in
+// the next block
+static const DWORD SIGNATURE_TAIL = 3;
+
+// the flags of the index
+static const DWORD SCANINDEX_RESCAN_INTERIOR = 0x1;
+
+
+bool ReadScanIndex(const QString &fileName, ScanIndex *index)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const QByteArray content = file.readAll();
+    const BYTE *data = reinterpret_cast<const BYTE *>(content.constData());
+    const BYTE *lastAddr = data + content.size();
+
+    try {
+        CheckBounds(data, lastAddr, SCANINDEX_MAGIC_SIZE + 7 * sizeof(DWORD));
+        if (memcmp(data, SCANINDEX_MAGIC, SCANINDEX_MAGIC_SIZE)) {
+            throw QString("invalid data format");
+        }
+        data += SCANINDEX_MAGIC_SIZE;
+
+        ScanIndex result;
+        result.blockSize = ReadDWord(data);
+        result.rescanInterior = (ReadDWord(data) & SCANINDEX_RESCAN_INTERIOR) != 0;
+        result.ofsFileEnd = ReadDWord(data);
+        result.fileSize = ReadQWord(data);
+        const DWORD blockCount = ReadDWord(data);
+        if (result.blockSize == 0
+                || blockCount != (result.fileSize + result.blockSize - 1) / result.blockSize) {
+            throw QString("invalid data format");
+        }
+
+        result.blocks.resize(blockCount);
+        for (DWORD i = 0; i < blockCount; ++i) {
+            ScanIndexBlock &block = result.blocks[i];
+            CheckBounds(data, lastAddr, 3 * sizeof(DWORD));
+            block.hash = ReadQWord(data);
+            const DWORD signatureCount = ReadDWord(data);
+            if (signatureCount > (lastAddr - data) / (2 * sizeof(DWORD))) {
+                throw QString("invalid data format");
+            }
+            block.signatures.resize(signatureCount);
+            for (DWORD j = 0; j < signatureCount; ++j) {
+                block.signatures[j].first = ReadDWord(data);
+                block.signatures[j].second = ReadDWord(data);
+            }
+        }
+
+        *index = result;
+    }
+    catch (...) {
+        return false;
+    }
+
+    return true;
+}
+
+
+bool WriteScanIndex(const QString &fileName, const ScanIndex &index)
+{
+    QByteArray data;
+    data.append(SCANINDEX_MAGIC, SCANINDEX_MAGIC_SIZE);
+    WriteDWord(&data, index.blockSize);
+    WriteDWord(&data, index.rescanInterior ? SCANINDEX_RESCAN_INTERIOR : 0);
+    WriteDWord(&data, index.ofsFileEnd);
+    WriteQWord(&data, index.fileSize);
+    WriteDWord(&data, index.blocks.count());
+    for (int i = 0; i < index.blocks.count(); ++i) {
+        const ScanIndexBlock &block = index.blocks[i];
+        WriteQWord(&data, block.hash);
+        WriteDWord(&data, block.signatures.count());
+        for (int j = 0; j < block.signatures.count(); ++j) {
+            WriteDWord(&data, block.signatures[j].first);
+            WriteDWord(&data, block.signatures[j].second);
+        }
+    }
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(data) != data.size()
+            || !file.commit()) {
+        return false;
+    }
+
+    return true;
+}
+
+
+qint64 CarveRecordsIncremental(const BYTE *firstDataAddr,
+                               const BYTE *lastDataAddr,
+                               const DBHeader &header,
+                               const QString &indexFileName,
+                               int threadCount, const CarveOptions &options,
+                               DBRecords *records)
+{
+    const qint64 dataSize = lastDataAddr - firstDataAddr;
+
+    ScanIndex oldIndex;
+    if (!ReadScanIndex(indexFileName, &oldIndex)
+            || oldIndex.blockSize != SCANINDEX_BLOCK_SIZE
+            || oldIndex.rescanInterior != options.rescanInterior) {
+        oldIndex = ScanIndex();
+    }
+
+    ScanIndex newIndex;
+    newIndex.blockSize = SCANINDEX_BLOCK_SIZE;
+    newIndex.rescanInterior = options.rescanInterior;
+    newIndex.ofsFileEnd = header.ofsFileEnd;
+    newIndex.fileSize = dataSize;
+    newIndex.blocks.resize((dataSize + SCANINDEX_BLOCK_SIZE - 1) / SCANINDEX_BLOCK_SIZE);
+
+    // the block is reused if it isn't changed and it isn't the space
+    // past the old end of the database, where miranda appends the new
+    // records. The last block of the old image is always rescanned: it
+    // was shorter, so its hash is different
+    const int blockCount = newIndex.blocks.count();
+    QVector<bool> reused(blockCount, false);
+    for (int i = 0; i < blockCount; ++i) {
+        const qint64 blockFrom = static_cast<qint64>(i) * SCANINDEX_BLOCK_SIZE;
+        const qint64 blockTo = qMin(blockFrom + SCANINDEX_BLOCK_SIZE, dataSize);
+        newIndex.blocks[i].hash = FastHash64(firstDataAddr + blockFrom, blockTo - blockFrom);
+        reused[i] = (i < oldIndex.blocks.count()
+                     && blockFrom < oldIndex.ofsFileEnd
+                     && oldIndex.blocks[i].hash == newIndex.blocks[i].hash);
+    }
+
+    // the records of the reused blocks are read at the known offsets,
+    // the signature which ends in the changed block is rescanned
+    CarvedRecords carved;
+    for (int i = 0; i < blockCount; ++i) {
+        if (!reused[i]) {
+            continue;
+        }
+
+        const qint64 blockTo = static_cast<qint64>(i + 1) * SCANINDEX_BLOCK_SIZE;
+        const bool nextChanged = (i + 1 < blockCount && !reused[i + 1]);
+        const QVector<QPair<DWORD, DWORD> > &signatures = oldIndex.blocks[i].signatures;
+        for (int j = 0; j < signatures.count(); ++j) {
+            const DWORD offset = signatures[j].first;
+            if (nextChanged && offset >= blockTo - SIGNATURE_TAIL) {
+                break;
+            }
+
+            if (offset + Q_INT64_C(4) > dataSize
+                    || ReadSignature(firstDataAddr + offset) != signatures[j].second) {
+                continue;
+            }
+
+            carved.signatures.append(offset);
+            ReadRecordAt(firstDataAddr, lastDataAddr, offset, options, &carved);
+        }
+    }
+
+    // the neighbouring changed blocks are carved as the one range
+    QVector<ScanRange> ranges;
+    qint64 carvedBytes = 0;
+    for (int i = 0; i < blockCount; ++i) {
+        if (reused[i]) {
+            continue;
+        }
+
+        qint64 from = static_cast<qint64>(i) * SCANINDEX_BLOCK_SIZE;
+        if (i > 0 && reused[i - 1]) {
+            from -= SIGNATURE_TAIL;
+        }
+        int last = i;
+        while (last + 1 < blockCount && !reused[last + 1]) {
+            ++last;
+        }
+
+        ScanRange range;
+        range.from = from;
+        range.to = qMin(static_cast<qint64>(last + 1) * SCANINDEX_BLOCK_SIZE, dataSize);
+        ranges.append(range);
+        carvedBytes += range.to - range.from;
+        i = last;
+    }
+
+    // the new index is built of the signatures
+    CarveOptions carveOptions = options;
+    carveOptions.keepSignatures = true;
+    CarvedRecords changed;
+    CarveRecords(firstDataAddr, lastDataAddr, ranges, threadCount, carveOptions, &changed);
+    MergeRecords(changed, &carved);
+    StoreRecords(firstDataAddr, &carved, records);
+
+    // the signatures are sorted, so each block gets the continuous part
+    for (int i = 0; i < carved.signatures.count(); ++i) {
+        const DWORD offset = carved.signatures[i];
+        newIndex.blocks[offset / SCANINDEX_BLOCK_SIZE].signatures.append(
+                    qMakePair(offset, ReadSignature(firstDataAddr + offset)));
+    }
+
+    // the interrupted scan misses the records of the changed blocks, the
+    // old index stays valid
+    if (IsStopRequested()) {
+        return carvedBytes;
+    }
+
+    if (!WriteScanIndex(indexFileName, newIndex)) {
+        std::cerr << "can't write the index file: " << indexFileName.toStdString() << std::endl;
+    }
+
+    return carvedBytes;
+}
@@ -0,0 +1,69 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef SCANINDEX_H
+#define SCANINDEX_H
+
+
+#include "recordcarver.h"
+#include <QPair>
+#include <QString>
+
+
+// The database image is divided into the blocks of the fixed size, for
+// each block the sidecar index keeps the hash of the content and the
+// offsets of the signatures which begin inside the block
+struct ScanIndexBlock {
+    quint64 hash;
+    QVector<QPair<DWORD, DWORD> > signatures;   // offset, signature
+};
+
+
+struct ScanIndex {
+    ScanIndex() : blockSize(0), rescanInterior(false), ofsFileEnd(0), fileSize(0) {}
+
+    DWORD blockSize;
+    bool rescanInterior;    // the signatures inside the strong records too
+    DWORD ofsFileEnd;
+    qint64 fileSize;
+    QVector<ScanIndexBlock> blocks;
+};
+
+
+// Reads the sidecar index, returns false if the file doesn't exist or
+// it isn't a valid index
+bool ReadScanIndex(const QString &fileName, ScanIndex *index);
+
+// Writes the sidecar index atomically, returns false on the failure
+bool WriteScanIndex(const QString &fileName, const ScanIndex &index);
+
+// Carves the database image using the index of the previous run: the
+// blocks with the same hash which lie before the old ofsFileEnd are not
+// scanned, their records are read at the known offsets; the other
+// blocks are carved by the brutforce algorithm. The index of the other
+// rescanInterior mode isn't used. The strong record which lies across
+// the border of the reused and the changed block doesn't hide the
+// signatures of the neighbouring block as in the full carve. The index
+// keeps the signatures of the rejected events too, so it doesn't depend
+// on the filter. The new index is written to the same file. Returns the
+// number of the carved bytes
+qint64 CarveRecordsIncremental(const BYTE *firstDataAddr,
+                               const BYTE *lastDataAddr,
+                               const DBHeader &header,
+                               const QString &indexFileName,
+                               int threadCount, const CarveOptions &options,
+                               DBRecords *records);
+
+
+#endif // SCANINDEX_H
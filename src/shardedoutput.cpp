@@ -0,0 +1,431 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "shardedoutput.h"
+#include "extractionschema.h"
+#include "jsonoutput.h"
+#include <QFileInfo>
+#include <QRunnable>
+#include <iostream>
+
+
+// the events of the batch of the worker; the events which may wait for
+// the workers and the ones which may be collected in the batches
+static const int SHARD_BATCH_SIZE = 4096;
+static const qint64 MAX_QUEUED_EVENTS = 16 * SHARD_BATCH_SIZE;
+static const qint64 MAX_PENDING_EVENTS = 16 * SHARD_BATCH_SIZE;
+// each open shard has the compressor thread and the buffers of about 2MB
+static const int MAX_OPEN_SHARDS = 32;
+
+static const char *const MANIFEST_FILE_NAME = "manifest.ndjson";
+
+
+class ShardedOutputVisitor::Task : public QRunnable
+{
+public:
+    Task(ShardedOutputVisitor *visitor, Shard *shard)
+        : m_visitor(visitor), m_shard(shard) {}
+
+    void run()
+    {
+        m_visitor->run(m_shard);
+    }
+
+private:
+    ShardedOutputVisitor *m_visitor;
+    Shard *m_shard;
+};
+
+
+ShardedOutputVisitor::ShardedOutputVisitor(const QString &directory,
+                                           const ExtractionSchema &schema,
+                                           const Miranda2JsonOptions &options)
+    : m_directory(directory), m_schema(schema), m_shardMode(options.shardMode),
+      m_shardSize(qMax(1, options.shardSize)), m_compression(options.compression),
+      m_userContactId(0), m_lastShard(0), m_eventCount(0), m_pendingEvents(0),
+      m_writtenBytes(0), m_opened(false), m_queuedEvents(0), m_error(false)
+{
+    m_pool.setMaxThreadCount(qMax(1, options.threadCount));
+}
+
+
+ShardedOutputVisitor::~ShardedOutputVisitor()
+{
+    m_pool.waitForDone();
+    qDeleteAll(m_shards);
+}
+
+
+const ExtractionSchema *ShardedOutputVisitor::schema() const
+{
+    return &m_schema;
+}
+
+
+bool ShardedOutputVisitor::eventOwnersRequired() const
+{
+    return m_shardMode == Miranda2JsonOptions::ContactShards;
+}
+
+
+void ShardedOutputVisitor::onBegin(const DBHeader &header)
+{
+    m_userContactId = header.ofsUser;
+
+    if (!m_directory.mkpath(".")) {
+        std::cerr << "can't create directory: " << m_directory.path().toStdString() << std::endl;
+        return;
+    }
+    m_opened = true;
+}
+
+
+void ShardedOutputVisitor::onContact(DWORD id, const DBContact &contact)
+{
+    Contact item;
+    item.id = id;
+    item.contact = contact;
+    m_contacts.append(item);
+}
+
+
+void ShardedOutputVisitor::onSettings(DWORD contactId, const ContactSettings &settings)
+{
+    if (contactId == m_userContactId) {
+        m_accounts = m_schema.accountsMap(contactId, settings);
+    }
+    if (!m_contacts.isEmpty() && m_contacts.last().id == contactId) {
+        m_contacts.last().settings = m_schema.contactSettingsMap(settings);
+    }
+}
+
+
+void ShardedOutputVisitor::onEvent(const EventView &event)
+{
+    if (!m_opened || !event.isMessage()) {
+        return;
+    }
+
+    Shard *eventShard;
+    if (m_shardMode == Miranda2JsonOptions::ContactShards) {
+        eventShard = shard(event.contactId(), event.contactId());
+    }
+    else {
+        eventShard = shard(m_eventCount / m_shardSize, 0);
+        // the events are counted in order, the previous shard is complete
+        if (m_lastShard && m_lastShard != eventShard) {
+            dispatch(m_lastShard, true);
+        }
+    }
+    m_lastShard = eventShard;
+    ++m_eventCount;
+
+    // the text is decoded here, the workers only format it
+    const DBEvent &dbEvent = event.event();
+    Event item;
+    item.id = event.id();
+    item.flags = dbEvent.flags;
+    item.moduleName = event.moduleName();
+    item.nextId = dbEvent.ofsNext;
+    item.prevId = dbEvent.ofsPrev;
+    item.text = event.text();
+    item.timestamp = dbEvent.timestamp;
+    eventShard->pending.append(item);
+    ++eventShard->eventCount;
+    ++m_pendingEvents;
+
+    if (eventShard->pending.count() >= SHARD_BATCH_SIZE) {
+        dispatch(eventShard);
+    }
+    else if (m_pendingEvents >= MAX_PENDING_EVENTS) {
+        // many contacts with the few events each
+        dispatchAll();
+    }
+}
+
+
+bool ShardedOutputVisitor::onEnd()
+{
+    if (!m_opened) {
+        return false;
+    }
+
+    dispatchAll();
+    m_pool.waitForDone();
+
+    // the workers are done, the shards are finished here
+    for (int i = 0; i < m_openShards.count(); ++i) {
+        m_error = !closeShard(m_openShards.at(i)) || m_error;
+    }
+    m_openShards.clear();
+    if (m_error) {
+        return false;
+    }
+
+    return writeManifest();
+}
+
+
+qint64 ShardedOutputVisitor::writtenBytes() const
+{
+    return m_writtenBytes;
+}
+
+
+ShardedOutputVisitor::Shard *ShardedOutputVisitor::shard(qint64 key, DWORD contactId)
+{
+    QMap<qint64, Shard *>::const_iterator it = m_shards.constFind(key);
+    if (it != m_shards.constEnd()) {
+        return it.value();
+    }
+
+    QString fileName;
+    if (m_shardMode == Miranda2JsonOptions::ContactShards) {
+        fileName = QString("contact-%1.ndjson").arg(contactId);
+    }
+    else {
+        fileName = QString("events-%1.ndjson").arg(key, 6, 10, QChar('0'));
+    }
+    if (m_compression == GzipCompression) {
+        fileName += ".gz";
+    }
+    else if (m_compression == ZstdCompression) {
+        fileName += ".zst";
+    }
+
+    Shard *shard = new Shard;
+    shard->fileName = fileName;
+    shard->contactId = contactId;
+    shard->eventCount = 0;
+    shard->busy = false;
+    shard->complete = false;
+    shard->created = false;
+    m_shards.insert(key, shard);
+
+    return shard;
+}
+
+
+// the complete shard is closed by the worker after its last batch
+void ShardedOutputVisitor::dispatch(Shard *shard, bool complete)
+{
+    if (shard->pending.isEmpty() && !complete) {
+        return;
+    }
+
+    const int count = shard->pending.count();
+    m_mutex.lock();
+    while (m_queuedEvents >= MAX_QUEUED_EVENTS) {
+        m_batchWritten.wait(&m_mutex);
+    }
+    m_queuedEvents += count;
+    if (count) {
+        shard->queue.enqueue(shard->pending);
+    }
+    if (complete) {
+        shard->complete = true;
+    }
+    if (!shard->busy) {
+        shard->busy = true;
+        m_pool.start(new Task(this, shard));
+    }
+    m_mutex.unlock();
+
+    m_pendingEvents -= count;
+    shard->pending.clear();
+}
+
+
+void ShardedOutputVisitor::dispatchAll()
+{
+    QMap<qint64, Shard *>::const_iterator it;
+    for (it = m_shards.constBegin(); it != m_shards.constEnd(); ++it) {
+        dispatch(it.value());
+    }
+}
+
+
+// the worker writes the batches of the shard until its queue is empty,
+// so the shard is written by one worker at a time
+void ShardedOutputVisitor::run(Shard *shard)
+{
+    m_mutex.lock();
+    while (!shard->queue.isEmpty()) {
+        const QVector<Event> events = shard->queue.dequeue();
+        const bool error = m_error;
+        m_mutex.unlock();
+
+        const bool ok = error || writeBatch(shard, events);
+
+        m_mutex.lock();
+        m_error = !ok || m_error;
+        m_queuedEvents -= events.count();
+        m_batchWritten.wakeAll();
+    }
+
+    if (shard->complete && shard->file) {
+        m_openShards.removeOne(shard);
+        m_mutex.unlock();
+        const bool ok = closeShard(shard);
+        m_mutex.lock();
+        m_error = !ok || m_error;
+    }
+    shard->busy = false;
+    m_mutex.unlock();
+}
+
+
+bool ShardedOutputVisitor::writeBatch(Shard *shard, const QVector<Event> &events)
+{
+    if (!shard->file && !openShard(shard)) {
+        return false;
+    }
+
+    for (int i = 0; i < events.count(); ++i) {
+        const Event &event = events.at(i);
+        shard->output->writeEvent(event.id, event.flags, event.moduleName, event.nextId,
+                                  event.prevId, event.text, event.timestamp);
+    }
+
+    m_mutex.lock();
+    m_openShards.removeOne(shard);
+    m_openShards.append(shard);
+    m_mutex.unlock();
+
+    return true;
+}
+
+
+// Opens the file of the shard for its batches. If too many shards are
+// open, the least recently written idle one is closed by this worker,
+// the batches which are queued for it meanwhile get the new worker
+bool ShardedOutputVisitor::openShard(Shard *shard)
+{
+    Shard *evicted = 0;
+    m_mutex.lock();
+    if (m_openShards.count() >= MAX_OPEN_SHARDS) {
+        for (int i = 0; i < m_openShards.count(); ++i) {
+            if (!m_openShards.at(i)->busy) {
+                evicted = m_openShards.takeAt(i);
+                evicted->busy = true;
+                break;
+            }
+        }
+    }
+    m_openShards.append(shard);
+    m_mutex.unlock();
+
+    if (evicted) {
+        const bool ok = closeShard(evicted);
+        m_mutex.lock();
+        m_error = !ok || m_error;
+        evicted->busy = !evicted->queue.isEmpty();
+        if (evicted->busy) {
+            m_pool.start(new Task(this, evicted));
+        }
+        m_mutex.unlock();
+    }
+
+    // the shard which was closed before is appended, the compressed
+    // streams are concatenated
+    shard->file.reset(new CompressedFile(m_directory.filePath(shard->fileName),
+                                         m_compression));
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    mode |= shard->created ? QIODevice::Append : QIODevice::Truncate;
+    if (!shard->file->open(mode)) {
+        std::cerr << "can't open file for write: "
+                  << shard->file->fileName().toStdString() << std::endl;
+        shard->file.reset();
+        m_mutex.lock();
+        m_openShards.removeOne(shard);
+        m_mutex.unlock();
+        return false;
+    }
+    shard->created = true;
+    shard->output.reset(new JsonOutput(shard->file.data(), true));
+
+    return true;
+}
+
+
+bool ShardedOutputVisitor::closeShard(Shard *shard)
+{
+    if (!shard->file) {
+        return true;
+    }
+
+    const bool ok = shard->output->finish() && shard->file->finish();
+    if (!ok) {
+        std::cerr << "can't write file: " << shard->file->fileName().toStdString() << std::endl;
+    }
+    shard->output.reset();
+    shard->file.reset();
+
+    return ok;
+}
+
+
+bool ShardedOutputVisitor::writeManifest()
+{
+    const QString fileName = m_directory.filePath(MANIFEST_FILE_NAME);
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "can't open file for write: " << fileName.toStdString() << std::endl;
+        return false;
+    }
+
+    JsonOutput output(&file, true);
+    output.writeAccounts(m_accounts);
+    for (int i = 0; i < m_contacts.count(); ++i) {
+        const Contact &item = m_contacts.at(i);
+        output.writeContact(item.id, item.contact.eventCount,
+                            item.contact.ofsFirstEvent,
+                            item.contact.ofsFirstUnreadEvent,
+                            item.contact.ofsLastEvent, item.settings);
+    }
+    if (!output.finish()) {
+        std::cerr << "can't write file: " << fileName.toStdString() << std::endl;
+        return false;
+    }
+
+    // {"shards": {"contact_id": id, "event_count": n, "file": name}}, the
+    // contact is 0 for the shards by the count
+    JsonWriter writer(&file);
+    m_writtenBytes = 0;
+    QMap<qint64, Shard *>::const_iterator it;
+    for (it = m_shards.constBegin(); it != m_shards.constEnd(); ++it) {
+        const Shard *shard = it.value();
+        writer.beginObject();
+        writer.writeKey("shards");
+        writer.beginObject();
+        writer.writeKey("contact_id");
+        writer.writeNumber(shard->contactId);
+        writer.writeKey("event_count");
+        writer.writeNumber(shard->eventCount);
+        writer.writeKey("file");
+        writer.writeString(shard->fileName);
+        writer.endObject();
+        writer.endObject();
+        writer.endLine();
+        m_writtenBytes += QFileInfo(m_directory.filePath(shard->fileName)).size();
+    }
+    if (!writer.flush()) {
+        std::cerr << "can't write file: " << fileName.toStdString() << std::endl;
+        return false;
+    }
+    file.close();
+    m_writtenBytes += QFileInfo(fileName).size();
+
+    return true;
+}
@@ -0,0 +1,132 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef SHARDEDOUTPUT_H
+#define SHARDEDOUTPUT_H
+
+
+#include "compressedfile.h"
+#include "recoveryvisitor.h"
+#include <QDir>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <QVector>
+#include <QWaitCondition>
+class JsonOutput;
+
+
+// Writes the recovered records to the directory: manifest.ndjson with
+// the accounts, the contacts and the list of the shards, and the event
+// shards with the {"events": item} lines. The events are split by the
+// contact of the event chain (the events which aren't in a chain are in
+// the shard of the contact 0) or by the count. The events are collected
+// into the batches, the batches are formatted and written by the worker
+// threads, the batches of one shard are written in order to its open
+// file, so the compressed shard is one stream. The number of the open
+// shards is limited, the least recently written idle one is closed and
+// the later batches are appended to it as the next stream. The visitor
+// waits when the workers fall behind
+class ShardedOutputVisitor : public RecoveryVisitor
+{
+public:
+    ShardedOutputVisitor(const QString &directory, const ExtractionSchema &schema,
+                         const Miranda2JsonOptions &options);
+    ~ShardedOutputVisitor();
+
+    const ExtractionSchema *schema() const;
+    bool eventOwnersRequired() const;
+
+    void onBegin(const DBHeader &header);
+    void onContact(DWORD id, const DBContact &contact);
+    void onSettings(DWORD contactId, const ContactSettings &settings);
+    void onEvent(const EventView &event);
+    bool onEnd();
+
+    // the size of the manifest and the shards, valid after onEnd()
+    qint64 writtenBytes() const;
+
+private:
+    Q_DISABLE_COPY(ShardedOutputVisitor)
+
+    struct Contact {
+        DWORD id;
+        DBContact contact;
+        QVariantMap settings;
+    };
+
+    struct Event {
+        DWORD id;
+        DWORD flags;
+        QString moduleName;
+        DWORD nextId;
+        DWORD prevId;
+        QString text;
+        DWORD timestamp;
+    };
+
+    struct Shard {
+        QString fileName;
+        DWORD contactId;
+        qint64 eventCount;
+        QVector<Event> pending;         // the batch which is being filled
+        // guarded by m_mutex
+        QQueue<QVector<Event> > queue;  // the batches for the worker
+        bool busy;                      // the worker writes the shard
+        bool complete;                  // no more batches, see dispatch()
+        // used by the worker which set busy
+        bool created;                   // the file is created by the worker
+        QScopedPointer<CompressedFile> file;
+        QScopedPointer<JsonOutput> output;
+    };
+
+    class Task;
+
+    Shard *shard(qint64 key, DWORD contactId);
+    void dispatch(Shard *shard, bool complete = false);
+    void dispatchAll();
+    void run(Shard *shard);
+    bool writeBatch(Shard *shard, const QVector<Event> &events);
+    bool openShard(Shard *shard);
+    bool closeShard(Shard *shard);
+    bool writeManifest();
+
+    QDir m_directory;
+    const ExtractionSchema &m_schema;
+    Miranda2JsonOptions::ShardMode m_shardMode;
+    int m_shardSize;
+    OutputCompression m_compression;
+    DWORD m_userContactId;
+    QVariantMap m_accounts;
+    QVector<Contact> m_contacts;
+    QMap<qint64, Shard *> m_shards;
+    Shard *m_lastShard;
+    qint64 m_eventCount;
+    qint64 m_pendingEvents;
+    qint64 m_writtenBytes;
+    bool m_opened;
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    QWaitCondition m_batchWritten;
+    qint64 m_queuedEvents;
+    QList<Shard *> m_openShards;        // the least recently written first
+    bool m_error;
+};
+
+
+#endif // SHARDEDOUTPUT_H
@@ -0,0 +1,197 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "signaturescanner.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIGNATURESCANNER_X86
+#include <immintrin.h>
+#endif
+
+
+// All record signatures are stored as little-endian DWORDs 0xXXDECADE,
+// so in the file they look like the bytes DE CA DE XX where XX is the tag:
+// 'C' (0x43) - DBContact, 'E' (0x45) - DBEvent, 'M' (0x4D) - DBModuleName,
+// 'S' (0x53) - DBContactSettings
+static const uchar SIGNATURE_BYTE0 = 0xDE;
+static const uchar SIGNATURE_BYTE1 = 0xCA;
+static const uchar SIGNATURE_BYTE2 = 0xDE;
+
+
+static inline bool IsRecordTag(uchar tag)
+{
+    return tag == 0x43 || tag == 0x45 || tag == 0x4D || tag == 0x53;
+}
+
+
+static qint64 FindRecordSignatureScalar(const uchar *data, qint64 from, qint64 size)
+{
+    qint64 i = from;
+    while (i + 4 <= size) {
+        const uchar *p = (const uchar *)memchr(data + i, SIGNATURE_BYTE0, size - 3 - i);
+        if (!p) {
+            break;
+        }
+
+        i = p - data;
+        if (p[1] == SIGNATURE_BYTE1 && p[2] == SIGNATURE_BYTE2 && IsRecordTag(p[3])) {
+            return i;
+        }
+
+        i += 1;
+    }
+
+    return size;
+}
+
+
+#ifdef SIGNATURESCANNER_X86
+// the loops below process 32 (SSE2) or 64 (AVX2) offsets per iteration,
+// the three unaligned loads at +0, +1 and +2 give the mask of the
+// offsets which begin with DE CA DE, the tag byte is checked only for them
+__attribute__((target("sse2")))
+static qint64 FindRecordSignatureSse2(const uchar *data, qint64 from, qint64 size)
+{
+    const __m128i b0 = _mm_set1_epi8((char)SIGNATURE_BYTE0);
+    const __m128i b1 = _mm_set1_epi8((char)SIGNATURE_BYTE1);
+    const __m128i b2 = _mm_set1_epi8((char)SIGNATURE_BYTE2);
+
+    qint64 i = from;
+    while (i + 32 + 3 <= size) {
+        const uchar *p = data + i;
+        const __m128i lo = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 0)), b0),
+                          _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 1)), b1)),
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 2)), b2));
+        const __m128i hi = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), b0),
+                          _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 17)), b1)),
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 18)), b2));
+
+        quint32 mask = (quint32)_mm_movemask_epi8(lo)
+                     | ((quint32)_mm_movemask_epi8(hi) << 16);
+        while (mask) {
+            const int bit = __builtin_ctz(mask);
+            if (IsRecordTag(p[bit + 3])) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+
+        i += 32;
+    }
+
+    return FindRecordSignatureScalar(data, i, size);
+}
+
+
+__attribute__((target("avx2")))
+static qint64 FindRecordSignatureAvx2(const uchar *data, qint64 from, qint64 size)
+{
+    const __m256i b0 = _mm256_set1_epi8((char)SIGNATURE_BYTE0);
+    const __m256i b1 = _mm256_set1_epi8((char)SIGNATURE_BYTE1);
+    const __m256i b2 = _mm256_set1_epi8((char)SIGNATURE_BYTE2);
+
+    qint64 i = from;
+    while (i + 64 + 3 <= size) {
+        const uchar *p = data + i;
+        const __m256i lo = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 0)), b0),
+                             _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 1)), b1)),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 2)), b2));
+        const __m256i hi = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 32)), b0),
+                             _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 33)), b1)),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 34)), b2));
+
+        quint64 mask = (quint64)(quint32)_mm256_movemask_epi8(lo)
+                     | ((quint64)(quint32)_mm256_movemask_epi8(hi) << 32);
+        while (mask) {
+            const int bit = __builtin_ctzll(mask);
+            if (IsRecordTag(p[bit + 3])) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+
+        i += 64;
+    }
+
+    return FindRecordSignatureSse2(data, i, size);
+}
+#endif
+
+
+struct RecordSignatureScanner {
+    FindRecordSignatureFunc func;
+    const char *name;
+};
+
+
+static RecordSignatureScanner SelectRecordSignatureScanner()
+{
+    RecordSignatureScanner scanner = { FindRecordSignatureScalar, "scalar" };
+#ifdef SIGNATURESCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanner.func = FindRecordSignatureAvx2;
+        scanner.name = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        scanner.func = FindRecordSignatureSse2;
+        scanner.name = "sse2";
+    }
+#endif
+
+    return scanner;
+}
+
+
+static const RecordSignatureScanner &GetRecordSignatureScanner()
+{
+    static const RecordSignatureScanner scanner = SelectRecordSignatureScanner();
+    return scanner;
+}
+
+
+qint64 FindRecordSignature(const uchar *data, qint64 from, qint64 size)
+{
+    return GetRecordSignatureScanner().func(data, from, size);
+}
+
+
+const char *RecordSignatureScannerName()
+{
+    return GetRecordSignatureScanner().name;
+}
+
+
+FindRecordSignatureFunc RecordSignatureScannerByName(const char *name)
+{
+    if (strcmp(name, "scalar") == 0) {
+        return FindRecordSignatureScalar;
+    }
+#ifdef SIGNATURESCANNER_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        return FindRecordSignatureSse2;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return FindRecordSignatureAvx2;
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef SIGNATURESCANNER_H
+#define SIGNATURESCANNER_H
+
+
+#include <QtGlobal>
+
+
+// Returns the offset of the first record signature (DBContact, DBEvent,
+// DBModuleName or DBContactSettings) in the range [from, size) of data,
+// or size if there is no signature. The implementation (AVX2, SSE2 or
+// scalar) is selected at runtime
+qint64 FindRecordSignature(const uchar *data, qint64 from, qint64 size);
+
+// Returns the name of the selected implementation
+const char *RecordSignatureScannerName();
+
+// Returns the implementation with the name ("scalar", "sse2" or "avx2") or
+// 0 if it isn't built or the cpu doesn't support it, used by the tests
+typedef qint64 (*FindRecordSignatureFunc)(const uchar *data, qint64 from, qint64 size);
+FindRecordSignatureFunc RecordSignatureScannerByName(const char *name);
+
+
+#endif // SIGNATURESCANNER_H
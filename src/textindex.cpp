@@ -0,0 +1,433 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "textindex.h"
+#include <QSaveFile>
+#include <QStringList>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+
+// the format of the index file (all numbers are little-endian):
+//   magic[8], eventCount, termCount, stringsSize, postingsSize
+//   eventCount * (id, timestamp), sorted by id
+//   termCount * (stringOffset, stringSize, postingsOffset, postingCount),
+//               sorted by the utf-8 term
+//   stringsSize bytes of the utf-8 terms
+//   postingsSize bytes of the postings: the differences of the sorted
+//               ids, 7 bits per byte, the high bit marks the next byte
+static const char TEXTINDEX_MAGIC[] = "MDBTXT01";
+static const int TEXTINDEX_MAGIC_SIZE = 8;
+static const int TEXTINDEX_TERM_FIELDS = 4;
+
+static const int MIN_TERM_SIZE = 2;
+static const int MAX_TERM_SIZE = 64;
+
+
+static void WriteVarint(QByteArray *data, DWORD value)
+{
+    while (value >= 0x80) {
+        data->append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    data->append(static_cast<char>(value));
+}
+
+
+static DWORD ReadVarint(const BYTE *&data, const BYTE *lastAddr)
+{
+    DWORD value = 0;
+    for (int shift = 0; shift < 32; shift += 7) {
+        CheckBounds(data, lastAddr, 1);
+        const BYTE byte = *(data++);
+        value |= static_cast<DWORD>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+
+    throw QString("invalid data format");
+}
+
+
+// the order of the terms in the file, the same for the writer and the
+// reader
+static int CompareTerms(const char *a, int aSize, const char *b, int bSize)
+{
+    const int result = memcmp(a, b, qMin(aSize, bSize));
+    if (result) {
+        return result;
+    }
+
+    return aSize - bSize;
+}
+
+
+typedef QPair<QByteArray, const QVector<DWORD> *> TermPostings;
+
+static bool TermLessThan(const TermPostings &a, const TermPostings &b)
+{
+    return CompareTerms(a.first.constData(), a.first.size(),
+                        b.first.constData(), b.first.size()) < 0;
+}
+
+
+QVector<QString> TokenizeText(const QString &text)
+{
+    QVector<QString> terms;
+    int from = -1;
+    for (int i = 0; i <= text.size(); ++i) {
+        const bool inTerm = (i < text.size() && text.at(i).isLetterOrNumber());
+        if (inTerm && from == -1) {
+            from = i;
+        }
+        else if (!inTerm && from != -1) {
+            const int size = i - from;
+            if (size >= MIN_TERM_SIZE) {
+                terms.append(text.mid(from, qMin(size, MAX_TERM_SIZE)).toCaseFolded());
+            }
+            from = -1;
+        }
+    }
+
+    return terms;
+}
+
+
+void TextIndexBuilder::addEvent(DWORD id, DWORD timestamp, const QString &text)
+{
+    // the postings are sorted by the id
+    if (!m_events.isEmpty() && m_events.last().first >= id) {
+        return;
+    }
+    m_events.append(qMakePair(id, timestamp));
+
+    const QVector<QString> terms = TokenizeText(text);
+    for (int i = 0; i < terms.count(); ++i) {
+        QVector<DWORD> &postings = m_postings[terms.at(i)];
+        if (postings.isEmpty() || postings.last() != id) {
+            postings.append(id);
+        }
+    }
+}
+
+
+bool TextIndexBuilder::write(const QString &fileName) const
+{
+    QVector<TermPostings> terms;
+    terms.reserve(m_postings.count());
+    QHash<QString, QVector<DWORD> >::const_iterator it;
+    for (it = m_postings.constBegin(); it != m_postings.constEnd(); ++it) {
+        terms.append(qMakePair(it.key().toUtf8(), &it.value()));
+    }
+    std::sort(terms.begin(), terms.end(), TermLessThan);
+
+    QByteArray table;
+    QByteArray strings;
+    QByteArray postings;
+    for (int i = 0; i < terms.count(); ++i) {
+        const QByteArray &term = terms.at(i).first;
+        const QVector<DWORD> &ids = *terms.at(i).second;
+        WriteDWord(&table, strings.size());
+        WriteDWord(&table, term.size());
+        WriteDWord(&table, postings.size());
+        WriteDWord(&table, ids.count());
+        strings.append(term);
+
+        DWORD previous = 0;
+        for (int j = 0; j < ids.count(); ++j) {
+            WriteVarint(&postings, ids.at(j) - previous);
+            previous = ids.at(j);
+        }
+    }
+
+    QByteArray data;
+    data.append(TEXTINDEX_MAGIC, TEXTINDEX_MAGIC_SIZE);
+    WriteDWord(&data, m_events.count());
+    WriteDWord(&data, terms.count());
+    WriteDWord(&data, strings.size());
+    WriteDWord(&data, postings.size());
+    for (int i = 0; i < m_events.count(); ++i) {
+        WriteDWord(&data, m_events.at(i).first);
+        WriteDWord(&data, m_events.at(i).second);
+    }
+    data.append(table);
+    data.append(strings);
+    data.append(postings);
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(data) != data.size()
+            || !file.commit()) {
+        return false;
+    }
+
+    return true;
+}
+
+
+TextIndex::TextIndex()
+    : m_map(0), m_eventCount(0), m_termCount(0), m_events(0), m_terms(0),
+      m_strings(0), m_stringsSize(0), m_postings(0), m_postingsSize(0)
+{
+}
+
+TextIndex::~TextIndex()
+{
+    close();
+}
+
+bool TextIndex::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    const qint64 size = m_file.size();
+    if (size > 0) {
+        m_map = m_file.map(0, size);
+    }
+    if (!m_map) {
+        m_errorString = "can't map the index";
+        close();
+        return false;
+    }
+
+    const BYTE *data = m_map;
+    const BYTE *lastAddr = m_map + size;
+    try {
+        CheckBounds(data, lastAddr, TEXTINDEX_MAGIC_SIZE + 4 * sizeof(DWORD));
+        if (memcmp(data, TEXTINDEX_MAGIC, TEXTINDEX_MAGIC_SIZE)) {
+            throw QString("invalid data format");
+        }
+        data += TEXTINDEX_MAGIC_SIZE;
+
+        const DWORD eventCount = ReadDWord(data);
+        const DWORD termCount = ReadDWord(data);
+        const DWORD stringsSize = ReadDWord(data);
+        const DWORD postingsSize = ReadDWord(data);
+        const quint64 expectedSize = eventCount * Q_UINT64_C(8)
+                + termCount * Q_UINT64_C(4) * TEXTINDEX_TERM_FIELDS
+                + stringsSize + postingsSize;
+        if (expectedSize != static_cast<quint64>(lastAddr - data)) {
+            throw QString("invalid data format");
+        }
+
+        m_eventCount = eventCount;
+        m_termCount = termCount;
+        m_events = data;
+        m_terms = m_events + eventCount * Q_UINT64_C(8);
+        m_strings = m_terms + termCount * sizeof(DWORD) * TEXTINDEX_TERM_FIELDS;
+        m_stringsSize = stringsSize;
+        m_postings = m_strings + stringsSize;
+        m_postingsSize = postingsSize;
+    }
+    catch (...) {
+        m_errorString = "it's not a text index";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void TextIndex::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = 0;
+    }
+    m_file.close();
+    m_eventCount = 0;
+    m_termCount = 0;
+    m_events = 0;
+    m_terms = 0;
+    m_strings = 0;
+    m_stringsSize = 0;
+    m_postings = 0;
+    m_postingsSize = 0;
+}
+
+// Compares the i-th term with the key. Returns false if the term doesn't
+// fit into the strings block, the index is damaged then
+bool TextIndex::compareTerm(int i, const QByteArray &key, int *result) const
+{
+    const qint64 field = static_cast<qint64>(i) * TEXTINDEX_TERM_FIELDS;
+    const DWORD stringOffset = DWordAt(m_terms, field);
+    const DWORD stringSize = DWordAt(m_terms, field + 1);
+    if (static_cast<quint64>(stringOffset) + stringSize > m_stringsSize) {
+        return false;
+    }
+
+    *result = CompareTerms((const char *)m_strings + stringOffset, stringSize,
+                           key.constData(), key.size());
+    return true;
+}
+
+QVector<DWORD> TextIndex::postings(const QString &term) const
+{
+    const QByteArray key = term.toUtf8();
+
+    int from = 0;
+    int count = m_termCount;
+    while (count > 0) {
+        const int step = count / 2;
+        int result;
+        if (!compareTerm(from + step, key, &result)) {
+            return QVector<DWORD>();
+        }
+
+        if (result < 0) {
+            from += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    QVector<DWORD> ids;
+    if (from == m_termCount) {
+        return ids;
+    }
+
+    // the binary search may stop on the term it has never probed
+    int result;
+    if (!compareTerm(from, key, &result) || result) {
+        return ids;
+    }
+
+    const qint64 field = static_cast<qint64>(from) * TEXTINDEX_TERM_FIELDS;
+    const DWORD postingsOffset = DWordAt(m_terms, field + 2);
+    const DWORD postingCount = DWordAt(m_terms, field + 3);
+    if (postingsOffset > m_postingsSize) {
+        return ids;
+    }
+
+    const BYTE *data = m_postings + postingsOffset;
+    const BYTE *lastAddr = m_postings + m_postingsSize;
+    try {
+        ids.reserve(qMin<quint64>(postingCount, lastAddr - data));
+        DWORD id = 0;
+        for (DWORD i = 0; i < postingCount; ++i) {
+            id += ReadVarint(data, lastAddr);
+            ids.append(id);
+        }
+    }
+    catch (...) {
+        ids.clear();
+    }
+
+    return ids;
+}
+
+bool TextIndex::timestamp(DWORD id, DWORD *timestamp) const
+{
+    int from = 0;
+    int count = m_eventCount;
+    while (count > 0) {
+        const int step = count / 2;
+        if (DWordAt(m_events, 2 * static_cast<qint64>(from + step)) < id) {
+            from += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    if (from == m_eventCount || DWordAt(m_events, 2 * static_cast<qint64>(from)) != id) {
+        return false;
+    }
+    *timestamp = DWordAt(m_events, 2 * static_cast<qint64>(from) + 1);
+
+    return true;
+}
+
+
+// the ids of the events with all terms of the words
+static QVector<DWORD> MatchAll(const TextIndex &index, const QStringList &words)
+{
+    QVector<QString> terms;
+    foreach (const QString &word, words) {
+        terms += TokenizeText(word);
+    }
+    if (terms.isEmpty()) {
+        return QVector<DWORD>();
+    }
+
+    QVector<DWORD> result = index.postings(terms.at(0));
+    for (int i = 1; i < terms.count() && !result.isEmpty(); ++i) {
+        const QVector<DWORD> ids = index.postings(terms.at(i));
+        QVector<DWORD> intersection(qMin(result.count(), ids.count()));
+        intersection.resize(std::set_intersection(result.constBegin(), result.constEnd(),
+                                                  ids.constBegin(), ids.constEnd(),
+                                                  intersection.begin())
+                            - intersection.begin());
+        result = intersection;
+    }
+
+    return result;
+}
+
+
+bool SearchTextIndex(const QString &indexFileName, const QString &query,
+                     const RecordFilter &filter, QVector<DWORD> *ids)
+{
+    TextIndex index;
+    if (!index.open(indexFileName)) {
+        std::cerr << "can't read the text index: " << indexFileName.toStdString()
+                  << " (" << index.errorString().toStdString() << ")" << std::endl;
+        return false;
+    }
+
+    // the alternatives of the words, AND is implied between the words
+    QVector<QStringList> alternatives(1);
+    foreach (const QString &word, query.split(' ', QString::SkipEmptyParts)) {
+        if (word == "OR") {
+            alternatives.append(QStringList());
+        }
+        else if (word != "AND") {
+            alternatives.last().append(word);
+        }
+    }
+
+    QVector<DWORD> result;
+    for (int i = 0; i < alternatives.count(); ++i) {
+        const QVector<DWORD> matched = MatchAll(index, alternatives.at(i));
+        QVector<DWORD> merged(result.count() + matched.count());
+        merged.resize(std::set_union(result.constBegin(), result.constEnd(),
+                                     matched.constBegin(), matched.constEnd(),
+                                     merged.begin())
+                      - merged.begin());
+        result = merged;
+    }
+
+    ids->clear();
+    for (int i = 0; i < result.count(); ++i) {
+        DWORD timestamp = 0;
+        if (index.timestamp(result.at(i), &timestamp)
+                && timestamp >= filter.since
+                && (!filter.until || timestamp < filter.until)) {
+            ids->append(result.at(i));
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,127 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+
+#include "mirandadb.h"
+#include "recordfilter.h"
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+
+// Splits the text into the terms: the runs of the letters and the
+// digits, case-folded, of 2 to 64 characters. The index and the search
+// use the same terms
+QVector<QString> TokenizeText(const QString &text);
+
+
+// Collects the terms of the messages while their texts are decoded and
+// writes the inverted index: the term -> the ids of the events. The
+// events must be added in the order of the ids
+class TextIndexBuilder
+{
+public:
+    void addEvent(DWORD id, DWORD timestamp, const QString &text);
+    bool write(const QString &fileName) const;
+
+    inline int eventCount() const;
+    inline int termCount() const;
+
+private:
+    QVector<QPair<DWORD, DWORD> > m_events;     // id, timestamp
+    QHash<QString, QVector<DWORD> > m_postings;
+};
+
+int TextIndexBuilder::eventCount() const
+{
+    return m_events.count();
+}
+
+int TextIndexBuilder::termCount() const
+{
+    return m_postings.count();
+}
+
+
+// The read-only inverted index, the file is mapped into the memory. The
+// terms are sorted, so the term is found by the binary search
+class TextIndex
+{
+public:
+    TextIndex();
+    ~TextIndex();
+
+    bool open(const QString &fileName);
+    void close();
+
+    inline int eventCount() const;
+    inline int termCount() const;
+
+    // the sorted ids of the events with the term
+    QVector<DWORD> postings(const QString &term) const;
+    // the timestamp of the indexed event, false if it isn't indexed
+    bool timestamp(DWORD id, DWORD *timestamp) const;
+
+    inline const QString &errorString() const;
+
+private:
+    Q_DISABLE_COPY(TextIndex)
+
+    bool compareTerm(int i, const QByteArray &key, int *result) const;
+
+    QFile m_file;
+    uchar *m_map;
+    int m_eventCount;
+    int m_termCount;
+    const uchar *m_events;
+    const uchar *m_terms;
+    const uchar *m_strings;
+    DWORD m_stringsSize;
+    const uchar *m_postings;
+    DWORD m_postingsSize;
+    QString m_errorString;
+};
+
+int TextIndex::eventCount() const
+{
+    return m_eventCount;
+}
+
+int TextIndex::termCount() const
+{
+    return m_termCount;
+}
+
+const QString &TextIndex::errorString() const
+{
+    return m_errorString;
+}
+
+
+// Finds the messages of the query in the index. The words of the query
+// are joined by AND, the alternatives are separated by OR, e.g.
+// "red apple OR pear" is (red AND apple) OR pear. The time range of the
+// filter is applied to the result. Returns false if the index can't be
+// read, the ids are sorted
+bool SearchTextIndex(const QString &indexFileName, const QString &query,
+                     const RecordFilter &filter, QVector<DWORD> *ids);
+
+
+#endif // TEXTINDEX_H
@@ -0,0 +1,197 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "textsanitizer.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TEXTSANITIZER_X86
+#include <immintrin.h>
+#endif
+
+
+static inline bool IsControlChar(uchar ch)
+{
+    return ch < 0x20 && ch != '\t' && ch != '\n' && ch != '\r';
+}
+
+
+static qint64 SanitizeTextScalar(const uchar *data, qint64 size, char *out, bool *ascii)
+{
+    uchar high = 0;
+    qint64 i = 0;
+    for (; i < size && data[i]; ++i) {
+        const uchar ch = data[i];
+        out[i] = IsControlChar(ch) ? ' ' : ch;
+        high |= ch;
+    }
+
+    *ascii = !(high & 0x80);
+    return i;
+}
+
+
+#ifdef TEXTSANITIZER_X86
+// the loops below process 16 (SSE2) or 32 (AVX2) bytes per iteration:
+// the control characters are found by the unsigned comparison with 0x1F
+// (min(x, 0x1F) == x) except the allowed ones and replaced by the
+// spaces, the high bits of the bytes are accumulated for the ascii test.
+// The iteration which contains the zero byte handles only the bytes
+// before it and stops the loop
+__attribute__((target("sse2")))
+static qint64 SanitizeTextSse2(const uchar *data, qint64 size, char *out, bool *ascii)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i maxControl = _mm_set1_epi8(0x1F);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lineFeed = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i space = _mm_set1_epi8(' ');
+
+    __m128i high = zero;
+    qint64 i = 0;
+    while (i + 16 <= size) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        const __m128i allowed = _mm_or_si128(_mm_cmpeq_epi8(v, tab),
+                                             _mm_or_si128(_mm_cmpeq_epi8(v, lineFeed),
+                                                          _mm_cmpeq_epi8(v, carriageReturn)));
+        const __m128i control = _mm_andnot_si128(
+                    allowed, _mm_cmpeq_epi8(_mm_min_epu8(v, maxControl), v));
+        _mm_storeu_si128((__m128i *)(out + i),
+                         _mm_or_si128(_mm_and_si128(control, space),
+                                      _mm_andnot_si128(control, v)));
+
+        const int zeroMask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        if (zeroMask) {
+            const int length = __builtin_ctz(zeroMask);
+            const int highMask = _mm_movemask_epi8(v) & ((1 << length) - 1);
+            *ascii = !(_mm_movemask_epi8(high) || highMask);
+            return i + length;
+        }
+
+        high = _mm_or_si128(high, v);
+        i += 16;
+    }
+
+    bool tailAscii = true;
+    const qint64 length = i + SanitizeTextScalar(data + i, size - i, out + i, &tailAscii);
+    *ascii = tailAscii && !_mm_movemask_epi8(high);
+    return length;
+}
+
+
+__attribute__((target("avx2")))
+static qint64 SanitizeTextAvx2(const uchar *data, qint64 size, char *out, bool *ascii)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i maxControl = _mm256_set1_epi8(0x1F);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lineFeed = _mm256_set1_epi8('\n');
+    const __m256i carriageReturn = _mm256_set1_epi8('\r');
+    const __m256i space = _mm256_set1_epi8(' ');
+
+    __m256i high = zero;
+    qint64 i = 0;
+    while (i + 32 <= size) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        const __m256i allowed = _mm256_or_si256(_mm256_cmpeq_epi8(v, tab),
+                                                _mm256_or_si256(_mm256_cmpeq_epi8(v, lineFeed),
+                                                                _mm256_cmpeq_epi8(v, carriageReturn)));
+        const __m256i control = _mm256_andnot_si256(
+                    allowed, _mm256_cmpeq_epi8(_mm256_min_epu8(v, maxControl), v));
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_blendv_epi8(v, space, control));
+
+        const quint32 zeroMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        if (zeroMask) {
+            const int length = __builtin_ctz(zeroMask);
+            const quint32 highMask = (quint32)_mm256_movemask_epi8(v)
+                                   & ((1u << length) - 1);
+            *ascii = !(_mm256_movemask_epi8(high) || highMask);
+            return i + length;
+        }
+
+        high = _mm256_or_si256(high, v);
+        i += 32;
+    }
+
+    bool tailAscii = true;
+    const qint64 length = i + SanitizeTextSse2(data + i, size - i, out + i, &tailAscii);
+    *ascii = tailAscii && !_mm256_movemask_epi8(high);
+    return length;
+}
+#endif
+
+
+struct TextSanitizer {
+    SanitizeTextFunc func;
+    const char *name;
+};
+
+
+static TextSanitizer SelectTextSanitizer()
+{
+    TextSanitizer sanitizer = { SanitizeTextScalar, "scalar" };
+#ifdef TEXTSANITIZER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        sanitizer.func = SanitizeTextAvx2;
+        sanitizer.name = "avx2";
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        sanitizer.func = SanitizeTextSse2;
+        sanitizer.name = "sse2";
+    }
+#endif
+
+    return sanitizer;
+}
+
+
+static const TextSanitizer &GetTextSanitizer()
+{
+    static const TextSanitizer sanitizer = SelectTextSanitizer();
+    return sanitizer;
+}
+
+
+qint64 SanitizeText(const uchar *data, qint64 size, char *out, bool *ascii)
+{
+    return GetTextSanitizer().func(data, size, out, ascii);
+}
+
+
+const char *TextSanitizerName()
+{
+    return GetTextSanitizer().name;
+}
+
+
+SanitizeTextFunc TextSanitizerByName(const char *name)
+{
+    if (strcmp(name, "scalar") == 0) {
+        return SanitizeTextScalar;
+    }
+#ifdef TEXTSANITIZER_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        return SanitizeTextSse2;
+    }
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return SanitizeTextAvx2;
+    }
+#endif
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef TEXTSANITIZER_H
+#define TEXTSANITIZER_H
+
+
+#include <QtGlobal>
+
+
+// Copies the text from data to out up to the first zero byte or up to
+// size bytes, the control characters except the tab, the line feed and
+// the carriage return are replaced by the spaces. Returns the size of
+// the text, ascii is set if the text has no bytes above 0x7F. The out
+// buffer must have size bytes. The implementation (AVX2, SSE2 or scalar)
+// is selected at runtime
+qint64 SanitizeText(const uchar *data, qint64 size, char *out, bool *ascii);
+
+// Returns the name of the selected implementation
+const char *TextSanitizerName();
+
+// Returns the implementation with the name ("scalar", "sse2" or "avx2") or
+// 0 if it isn't built or the cpu doesn't support it, used by the tests
+typedef qint64 (*SanitizeTextFunc)(const uchar *data, qint64 size, char *out,
+                                   bool *ascii);
+SanitizeTextFunc TextSanitizerByName(const char *name);
+
+
+#endif // TEXTSANITIZER_H
@@ -0,0 +1,42 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "tst_recordcarver.h"
+#include "tst_signaturescanner.h"
+#include "tst_textsanitizer.h"
+#include <QCoreApplication>
+#include <QtTest>
+
+
+// runs all the test classes, the application is built with "QT += testlib"
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    int status = 0;
+    {
+        TstRecordCarver test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TstSignatureScanner test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+    {
+        TstTextSanitizer test;
+        status |= QTest::qExec(&test, argc, argv);
+    }
+
+    return status;
+}
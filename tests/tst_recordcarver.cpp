@@ -0,0 +1,128 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "tst_recordcarver.h"
+#include "recordcarver.h"
+#include "syntheticdb.h"
+#include <QtTest>
+#include <cstring>
+
+
+static void CarveDb(const QByteArray &db, int threadCount,
+                    const CarveOptions &options, CarvedRecords *records)
+{
+    const BYTE *firstDataAddr = reinterpret_cast<const BYTE *>(db.constData());
+    const BYTE *lastDataAddr = firstDataAddr + db.size();
+
+    ScanRange range;
+    range.from = 0;
+    range.to = db.size();
+    CarveRecords(firstDataAddr, lastDataAddr, QVector<ScanRange>() << range,
+                 threadCount, options, records);
+}
+
+
+// the signatures inside the texts of the events, the scan which begins
+// inside the event finds them, the scan which jumps over the event
+// doesn't
+static void PlantSignatures(QByteArray *db)
+{
+    CarvedRecords records;
+    CarveDb(*db, 1, CarveOptions(), &records);
+    for (int i = 0; i < records.events.count(); ++i) {
+        const DBView blob = records.events.blob(i);
+        if (blob.size >= 8) {
+            const DWORD signature = DBEVENT_SIGNATURE;
+            memcpy(db->data() + blob.offset + blob.size / 2 - 2,
+                   &signature, sizeof(signature));
+        }
+    }
+}
+
+
+static void CompareRecords(const CarvedRecords &records, const CarvedRecords &expected)
+{
+    QCOMPARE(records.signatures, expected.signatures);
+    QCOMPARE(records.weakRecords, expected.weakRecords);
+    QCOMPARE(records.contacts.offsets(), expected.contacts.offsets());
+    QCOMPARE(records.events.offsets(), expected.events.offsets());
+    QCOMPARE(records.moduleNames.offsets(), expected.moduleNames.offsets());
+    QCOMPARE(records.contactSettings.offsets(), expected.contactSettings.offsets());
+    QCOMPARE(records.scanEnd, expected.scanEnd);
+    for (int i = 0; i < RecordTypeCount; ++i) {
+        QCOMPARE(records.counters.hits[i], expected.counters.hits[i]);
+        QCOMPARE(records.counters.failures[i], expected.counters.failures[i]);
+        QCOMPARE(records.counters.weak[i], expected.counters.weak[i]);
+        QCOMPARE(records.counters.filtered[i], expected.counters.filtered[i]);
+    }
+}
+
+
+// all the records of the valid database are found, the scan jumps over
+// them, so the signatures inside the texts aren't even examined
+void TstRecordCarver::intactDatabase()
+{
+    SyntheticDbOptions options;
+    options.contactCount = 50;
+    options.eventsPerContact = 50;
+    SyntheticDbStats stats;
+    const QByteArray db = GenerateSyntheticDb(options, &stats);
+
+    CarvedRecords records;
+    CarveDb(db, 1, CarveOptions(), &records);
+    QCOMPARE(static_cast<qint64>(records.contacts.count()), stats.contactCount);
+    QCOMPARE(static_cast<qint64>(records.events.count()), stats.eventCount);
+    QCOMPARE(static_cast<qint64>(records.moduleNames.count()), stats.moduleNameCount);
+    QCOMPARE(static_cast<qint64>(records.contactSettings.count()), stats.settingsCount);
+    QVERIFY(records.weakRecords.isEmpty());
+}
+
+
+// the damaged database of several chunks: the chunks begin inside the
+// events, they are rescanned from the end of the event of the previous
+// chunk, so the result must be the same as the one of the single thread.
+// The signatures are kept only if they are asked for
+void TstRecordCarver::threadCount()
+{
+    SyntheticDbOptions dbOptions;
+    dbOptions.contactCount = 200;
+    dbOptions.eventsPerContact = 200;
+    dbOptions.zeroedPages = 20;
+    dbOptions.truncatedChains = 20;
+    dbOptions.bitFlips = 500;
+    QByteArray db = GenerateSyntheticDb(dbOptions);
+    PlantSignatures(&db);
+    QVERIFY(db.size() > 4 * 1024 * 1024);
+
+    static const int threadCounts[] = { 2, 3, 4, 7, 16 };
+    for (int mode = 0; mode < 4; ++mode) {
+        CarveOptions options;
+        options.rescanInterior = mode & 1;
+        options.keepSignatures = mode & 2;
+
+        CarvedRecords expected;
+        CarveDb(db, 1, options, &expected);
+        QVERIFY(!expected.events.isEmpty());
+        QCOMPARE(expected.signatures.isEmpty(), !options.keepSignatures);
+
+        for (int threadCount : threadCounts) {
+            CarvedRecords records;
+            CarveDb(db, threadCount, options, &records);
+            CompareRecords(records, expected);
+            if (QTest::currentTestFailed()) {
+                return;
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#ifndef TST_RECORDCARVER_H
+#define TST_RECORDCARVER_H
+
+
+#include <QObject>
+
+
+// Carves the synthetic databases, see bench/syntheticdb.h
+class TstRecordCarver : public QObject
+{
+    Q_OBJECT
+private slots:
+    void intactDatabase();
+    void threadCount();
+};
+
+
+#endif // TST_RECORDCARVER_H
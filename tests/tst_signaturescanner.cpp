@@ -0,0 +1,130 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "tst_signaturescanner.h"
+#include "signaturescanner.h"
+#include <QtTest>
+
+
+static const char *const SIMD_SCANNERS[] = { "sse2", "avx2" };
+
+
+// the bytes of the signatures are frequent in the random data, so the
+// partial matches (DE, DE CA, DE CA DE with a wrong tag) are frequent too
+static QByteArray RandomData(int size, quint32 seed)
+{
+    static const uchar alphabet[] = { 0xDE, 0xCA, 0x43, 0x45, 0x4D, 0x53, 0x00, 0x44 };
+
+    QByteArray data(size, 0);
+    quint32 state = seed;
+    for (int i = 0; i < size; ++i) {
+        state = state * 1664525 + 1013904223;
+        data[i] = (char)alphabet[(state >> 24) % sizeof(alphabet)];
+    }
+
+    return data;
+}
+
+
+static QVector<qint64> FindAll(FindRecordSignatureFunc func,
+                               const QByteArray &data, qint64 from, qint64 size)
+{
+    const uchar *p = (const uchar *)data.constData();
+
+    QVector<qint64> offsets;
+    for (qint64 i = func(p, from, size); i < size; i = func(p, i + 1, size)) {
+        offsets.append(i);
+    }
+
+    return offsets;
+}
+
+
+void TstSignatureScanner::randomData()
+{
+    FindRecordSignatureFunc scalar = RecordSignatureScannerByName("scalar");
+    QVERIFY(scalar);
+
+    for (const char *name : SIMD_SCANNERS) {
+        FindRecordSignatureFunc simd = RecordSignatureScannerByName(name);
+        if (!simd) {
+            continue;
+        }
+
+        for (quint32 seed = 1; seed <= 16; ++seed) {
+            const QByteArray data = RandomData(64 * 1024 + seed, seed);
+            const QVector<qint64> expected = FindAll(scalar, data, 0, data.size());
+            QVERIFY(!expected.isEmpty());
+            QCOMPARE(FindAll(simd, data, 0, data.size()), expected);
+        }
+    }
+}
+
+
+// all the ranges shorter than two vectors, so the whole range or its
+// end is processed by the scalar tail of the SIMD loops
+void TstSignatureScanner::tails()
+{
+    FindRecordSignatureFunc scalar = RecordSignatureScannerByName("scalar");
+    const QByteArray data = RandomData(160, 7);
+
+    for (const char *name : SIMD_SCANNERS) {
+        FindRecordSignatureFunc simd = RecordSignatureScannerByName(name);
+        if (!simd) {
+            continue;
+        }
+
+        for (qint64 size = 0; size <= data.size(); ++size) {
+            for (qint64 from = 0; from <= size; ++from) {
+                QCOMPARE(FindAll(simd, data, from, size),
+                         FindAll(scalar, data, from, size));
+            }
+        }
+    }
+}
+
+
+// one signature at every offset: across the boundary of the 16 and 32
+// byte vectors and of the iterations, at the end and past the end of the
+// range
+void TstSignatureScanner::straddling()
+{
+    static const uchar signature[] = { 0xDE, 0xCA, 0xDE, 0x45 };
+    static const int size = 200;
+
+    FindRecordSignatureFunc scalar = RecordSignatureScannerByName("scalar");
+    for (const char *name : SIMD_SCANNERS) {
+        FindRecordSignatureFunc simd = RecordSignatureScannerByName(name);
+        if (!simd) {
+            continue;
+        }
+
+        for (int offset = 0; offset + 4 <= size; ++offset) {
+            QByteArray data(size, 0);
+            memcpy(data.data() + offset, signature, sizeof(signature));
+            // a partial signature just before the real one
+            if (offset >= 3) {
+                data[offset - 3] = (char)0xDE;
+                data[offset - 2] = (char)0xCA;
+            }
+
+            const uchar *p = (const uchar *)data.constData();
+            QCOMPARE(simd(p, 0, size), (qint64)offset);
+            QCOMPARE(scalar(p, 0, size), (qint64)offset);
+            // the range ends inside the signature
+            QCOMPARE(simd(p, 0, offset + 3), (qint64)offset + 3);
+            QCOMPARE(simd(p, offset + 1, size), (qint64)size);
+        }
+    }
+}
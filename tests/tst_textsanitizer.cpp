@@ -0,0 +1,164 @@
+// Copyright 2016, Durachenko Aleksey V. <durachenko.aleksey@gmail.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#include "tst_textsanitizer.h"
+#include "textsanitizer.h"
+#include <QtTest>
+
+
+static const char *const SIMD_SANITIZERS[] = { "sse2", "avx2" };
+
+
+// the printable text with the control characters, the allowed ones and
+// the bytes above 0x7F, the zero byte is rare so the texts are long
+static QByteArray RandomText(int size, quint32 seed)
+{
+    QByteArray data(size, 0);
+    quint32 state = seed;
+    for (int i = 0; i < size; ++i) {
+        state = state * 1664525 + 1013904223;
+        const quint32 r = state >> 16;
+        if (r % 8 == 0) {
+            data[i] = (char)(r % 0x20);
+        }
+        else if (r % 8 == 1) {
+            data[i] = (char)(0x80 | (r >> 8));
+        }
+        else {
+            data[i] = (char)(0x20 + (r >> 8) % 0x60);
+        }
+        // the zero stops the text
+        if (r % 256 == 0) {
+            data[i] = 0;
+        }
+    }
+
+    return data;
+}
+
+
+// the text, its size and the ascii flag of the implementation, the
+// bytes of the out buffer after the text are undefined
+static QByteArray Sanitize(SanitizeTextFunc func, const QByteArray &data,
+                           int from, int size, bool *ascii)
+{
+    QByteArray out(size, 0);
+    const qint64 length = func((const uchar *)data.constData() + from, size, out.data(), ascii);
+    return out.left(length);
+}
+
+
+static void CompareWithScalar(SanitizeTextFunc simd, const QByteArray &data,
+                              int from, int size)
+{
+    bool ascii = false;
+    bool expectedAscii = true;
+    const QByteArray text = Sanitize(simd, data, from, size, &ascii);
+    const QByteArray expected = Sanitize(TextSanitizerByName("scalar"), data,
+                                         from, size, &expectedAscii);
+    QCOMPARE(text, expected);
+    QCOMPARE(ascii, expectedAscii);
+}
+
+
+void TstTextSanitizer::randomData()
+{
+    QVERIFY(TextSanitizerByName("scalar"));
+
+    for (const char *name : SIMD_SANITIZERS) {
+        SanitizeTextFunc simd = TextSanitizerByName(name);
+        if (!simd) {
+            continue;
+        }
+
+        for (quint32 seed = 1; seed <= 64; ++seed) {
+            const QByteArray data = RandomText(4096 + seed, seed);
+            for (int from = 0; from < data.size(); from += 97) {
+                CompareWithScalar(simd, data, from, data.size() - from);
+                if (QTest::currentTestFailed()) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+
+// all the sizes up to three vectors without the zero byte, so the end of
+// the text is handled by the scalar tail of the SIMD loops
+void TstTextSanitizer::tails()
+{
+    QByteArray data = RandomText(100, 3);
+    data.replace('\0', ' ');
+
+    for (const char *name : SIMD_SANITIZERS) {
+        SanitizeTextFunc simd = TextSanitizerByName(name);
+        if (!simd) {
+            continue;
+        }
+
+        for (int size = 0; size <= data.size(); ++size) {
+            for (int from = 0; from + size <= data.size(); from += 7) {
+                CompareWithScalar(simd, data, from, size);
+                if (QTest::currentTestFailed()) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+
+// the zero byte, the control character and the byte above 0x7F at every
+// offset: across the boundary of the vectors, the high byte just before
+// and just after the zero
+void TstTextSanitizer::straddling()
+{
+    static const int size = 100;
+    const QByteArray text(size, 'a');
+
+    for (const char *name : SIMD_SANITIZERS) {
+        SanitizeTextFunc simd = TextSanitizerByName(name);
+        if (!simd) {
+            continue;
+        }
+
+        for (int offset = 0; offset < size; ++offset) {
+            QByteArray data = text;
+            data[offset] = 0;
+            CompareWithScalar(simd, data, 0, size);
+
+            data = text;
+            data[offset] = 0x01;
+            CompareWithScalar(simd, data, 0, size);
+
+            data = text;
+            data[offset] = (char)0xC3;
+            CompareWithScalar(simd, data, 0, size);
+
+            // the high byte after the zero doesn't make the text non-ascii
+            data = text;
+            data[offset] = 0;
+            data[qMin(offset + 1, size - 1)] = (char)0xC3;
+            CompareWithScalar(simd, data, 0, size);
+            if (offset > 0) {
+                data[offset - 1] = (char)0xC3;
+                CompareWithScalar(simd, data, 0, size);
+            }
+            if (QTest::currentTestFailed()) {
+                return;
+            }
+        }
+    }
+}